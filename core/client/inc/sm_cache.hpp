@@ -0,0 +1,83 @@
+/**
+ * @file sm_cache.hpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#ifndef SM_CACHE_H
+#define SM_CACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace sm
+{
+
+using CacheClock = std::chrono::steady_clock;
+
+struct RegisterRange
+{
+    RegisterRange() = default;
+    RegisterRange(std::uint16_t start, std::uint16_t quantity) : start(start), quantity(quantity) {}
+    std::uint16_t start = 0;    // register start address in Modbus application layer
+    std::uint16_t quantity = 0; // amount of registers
+};
+
+class RegisterCache
+{
+public:
+    /**
+     * @brief store values read from or written to the server
+     *
+     * @param start register start address in Modbus application layer
+     * @param values register values
+     * @param time time when values were received
+     */
+    void update(const std::uint16_t start, const std::vector<std::uint16_t>& values, const CacheClock::time_point time = CacheClock::now());
+    /**
+     * @brief mark range as stale, values will be requested from the server on the next cached read
+     *
+     */
+    void invalidate(const RegisterRange& range);
+    void clear() { entries.clear(); }
+    /**
+     * @brief get values from cache
+     *
+     * @param range requested registers
+     * @param max_age maximum age of every value in range
+     * @param values output values
+     * @return true if all registers are cached and not older than max_age
+     */
+    bool read(const RegisterRange& range, const std::chrono::milliseconds max_age, std::vector<std::uint16_t>& values,
+              const CacheClock::time_point now = CacheClock::now()) const;
+    /**
+     * @brief get minimal list of read requests to refresh stale registers
+     *
+     * @param ranges requested registers, may overlap
+     * @param max_age maximum age of cached value
+     * @param max_quantity maximum amount of registers in one request
+     * @return ranges to read, fresh registers are read again only if they are inside requested ranges and join two stale parts
+     */
+    std::vector<RegisterRange> getStaleRanges(const std::vector<RegisterRange>& ranges, const std::chrono::milliseconds max_age,
+                                              const std::uint16_t max_quantity, const CacheClock::time_point now = CacheClock::now()) const;
+
+private:
+    struct Entry
+    {
+        std::uint16_t value = 0;
+        CacheClock::time_point updated;
+        bool valid = false;
+    };
+    std::map<std::uint16_t, Entry> entries;
+
+    bool isFresh(const std::uint16_t address, const std::chrono::milliseconds max_age, const CacheClock::time_point now) const;
+};
+
+} // namespace sm
+
+#endif // SM_CACHE_H
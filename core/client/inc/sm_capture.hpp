@@ -0,0 +1,106 @@
+/**
+ * @file sm_capture.hpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#ifndef SM_CAPTURE_H
+#define SM_CAPTURE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "../inc/sm_ring.hpp"
+#include "../../common/sm_pcap.hpp"
+
+namespace sm
+{
+
+// about 256 KB of frames, several seconds of a fully loaded bus at 115200
+constexpr size_t capture_ring_size = 1024;
+constexpr int capture_flush_period_ms = 100;
+
+struct CaptureStatistics
+{
+    std::uint64_t captured = 0; // frames passed to the ring
+    std::uint64_t dropped = 0;  // frames lost because the ring was full
+    std::uint64_t written = 0;  // frames written to the file
+};
+
+// frames are copied to a preallocated ring by the exchange thread, a background thread writes them to a pcap file.
+// Exchange thread never allocates, locks or performs I/O, if the writer is behind frames are dropped and counted
+class FrameCapture
+{
+public:
+    FrameCapture() = default;
+    ~FrameCapture() { stop(); }
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+    /**
+     * @brief create pcap file and start writer thread, capture in progress is stopped first
+     *
+     * @param path path to file
+     * @return false if file can not be created
+     */
+    bool start(const std::string& path);
+    /**
+     * @brief write frames left in the ring and close the file
+     *
+     */
+    void stop();
+    bool isActive() const { return active.load(std::memory_order_acquire); }
+    /**
+     * @brief store frame, called only by the thread performing exchanges
+     *
+     * @param direction request or response
+     * @param data frame with address and CRC
+     * @param length frame length, frames longer than modbus::max_adu_size are truncated
+     * @param time moment of the frame on the bus
+     */
+    void record(const CaptureDirection direction, const std::uint8_t* data, const size_t length, const std::chrono::steady_clock::time_point time);
+    CaptureStatistics getStatistics() const;
+
+private:
+    struct Frame
+    {
+        std::chrono::steady_clock::time_point time;
+        std::uint16_t length = 0;
+        CaptureDirection direction = CaptureDirection::request;
+        std::array<std::uint8_t, modbus::max_adu_size> data;
+    };
+    using Ring = SpscRing<Frame, capture_ring_size>;
+    // allocated on the first start and kept until destruction, exchange thread may still use it right after stop
+    std::unique_ptr<Ring> ring;
+    std::atomic<bool> active{false};
+    std::atomic<std::uint64_t> captured{0};
+    std::atomic<std::uint64_t> dropped{0};
+    std::atomic<std::uint64_t> written{0};
+    // start and stop may be called from several application threads
+    std::mutex control_mutex;
+    std::mutex writer_mutex;
+    std::condition_variable writer_wake_up;
+    bool writer_stop = false; // protected by writer_mutex
+    std::thread writer;
+    std::FILE* file = nullptr;
+    // steady time of frames is converted to wall clock time for the file
+    std::chrono::system_clock::time_point wall_base;
+    std::chrono::steady_clock::time_point steady_base;
+    void writerThread();
+    void drain();
+    // control_mutex must be locked
+    void close();
+};
+
+} // namespace sm
+
+#endif // SM_CAPTURE_H
@@ -11,36 +11,51 @@
 #define SM_CLIENT_H
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <future>
+#include <mutex>
 #include <queue>
 #include <thread>
 #include <vector>
 
+#include "../../common/sm_common.hpp"
 #include "../../common/sm_modbus.hpp"
 #include "../../external/simple-serial-port/inc/serial_port.hpp"
+#include "../inc/sm_cache.hpp"
 #include "../inc/sm_file.hpp"
 #include "../inc/sm_message.hpp"
+#include "../inc/sm_poll.hpp"
+#include "../inc/sm_capture.hpp"
+#include "../inc/sm_metrics.hpp"
+#include "../inc/sm_subscription.hpp"
 
 namespace sm
 {
 
 constexpr int server_not_found = -1;
 constexpr int default_task_wait_delay_ms = 50;
+constexpr int progress_print_period_ms = 100;
 constexpr int task_complete_value = 100;
 constexpr int task_not_started_value = 0;
-constexpr std::uint16_t file_read_prepare = 1;
-constexpr std::uint16_t file_write_prepare = 2;
 constexpr std::uint16_t app_erase_request = 1;
+constexpr int default_broadcast_processing_us = 2000;
+constexpr int max_broadcast_repair_rounds = 3;
 
 enum class ClientTasks
 {
     undefined,
     regs_read,
     reg_write,
+    regs_write,
+    regs_read_write,
     file_read,
     file_write,
+    file_broadcast, // records to broadcast address, no responses
+    record_map_read, // read of FileDefinitions::record_map, used after broadcast
     ping, // extra command, FunctionCodes::undefined used
 };
 
@@ -48,8 +63,11 @@ struct TaskAttributes
 {
     TaskAttributes() = default;
     TaskAttributes(modbus::FunctionCodes code, size_t length) : code(code), length(length) {}
+    TaskAttributes(modbus::FunctionCodes code, std::chrono::microseconds pause) : code(code), pause(pause) {}
     modbus::FunctionCodes code = modbus::FunctionCodes::undefined;
     size_t length = 0;
+    // broadcast request has no response, the bus is kept silent for this time after the request is written
+    std::chrono::microseconds pause{0};
 };
 
 struct TaskInfo
@@ -59,18 +77,20 @@ struct TaskInfo
     ClientTasks task = ClientTasks::undefined;
     TaskAttributes attributes;
     std::error_code error_code;
-    int num_of_exchanges = 0;
-    int counter = 0;
+    // progress may be read by the application while client thread executes the task
+    std::atomic<int> num_of_exchanges{0};
+    std::atomic<int> counter{0};
     int index = -1;
-    bool is_printable = false;
+    // progress bar is printed by the thread waiting for the task
+    std::atomic<bool> is_printable{false};
     std::atomic<bool> done{false};
     void reset(ClientTasks task = ClientTasks::undefined, int num_of_exchanges = 0, int index = -1, bool is_printable = false)
     {
         this->task = task;
         this->num_of_exchanges = num_of_exchanges;
         this->index = index;
-        this->is_printable = is_printable;
-        counter = 0;
+        this->is_printable.store(is_printable, std::memory_order_relaxed);
+        counter.store(0, std::memory_order_relaxed);
         done.store(false, std::memory_order_relaxed);
         attributes = TaskAttributes();
         error_code = std::error_code();
@@ -91,6 +111,8 @@ struct ServerInfo
     std::uint8_t record_size = 0;
     // the server will be marked as available if ClientTasks::ping completes successfully
     ServerStatus status = ServerStatus::unavailable;
+    // last value written to gateway_buffer_size register of this gateway, 0 if unknown
+    std::uint16_t gateway_buffer_size = 0;
 };
 
 struct ServerRegisters
@@ -103,6 +125,8 @@ struct ServerData
 {
     ServerInfo info;
     ServerRegisters registers;
+    // every successful register read or write is stored here
+    RegisterCache cache;
 };
 
 class ModbusClient
@@ -111,7 +135,11 @@ public:
     ModbusClient() : client_thread(&ModbusClient::clientThread, this) {}
     ~ModbusClient()
     {
-        thread_stop.store(true, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lk(wait_mutex);
+            thread_stop.store(true, std::memory_order_relaxed);
+        }
+        client_wake_up.notify_one();
         client_thread.join();
     }
     sp::SerialPort serial_port;
@@ -122,7 +150,7 @@ public:
      */
     void stop();
     /**
-     * @brief adds server to the vector with used servers
+     * @brief adds server to the list of used servers
      *
      * @param dev_addr server address in Modbus application layer
      * @param gateway_addr gateway address in case of gateway access
@@ -167,6 +195,91 @@ public:
      * @return std::error_code
      */
     std::error_code taskReadRegisters(const std::uint8_t dev_addr, const std::uint16_t reg_addr, const std::uint16_t quantity, const bool print_progress = false);
+    /**
+     * @brief write block of registers in one exchange
+     *
+     * @param dev_addr server address in Modbus application layer
+     * @param reg_addr register start address in Modbus application layer
+     * @param values new register values, up to modbus::max_amount_of_write_regs
+     * @return std::error_code
+     */
+    std::error_code taskWriteRegisters(const std::uint8_t dev_addr, const std::uint16_t reg_addr, const std::vector<std::uint16_t>& values,
+                                       const bool print_progress = false);
+    /**
+     * @brief write block of registers and read registers back in one exchange, write is performed first
+     *
+     * @param dev_addr server address in Modbus application layer
+     * @param write_addr write start address in Modbus application layer
+     * @param values new register values, up to modbus::max_amount_of_read_write_regs
+     * @param read_addr read start address in Modbus application layer
+     * @param quantity amount of registers to read
+     * @return std::error_code
+     */
+    std::error_code taskReadWriteRegisters(const std::uint8_t dev_addr, const std::uint16_t write_addr, const std::vector<std::uint16_t>& values,
+                                           const std::uint16_t read_addr, const std::uint16_t quantity, const bool print_progress = false);
+    /**
+     * @brief read registers which are not in cache or older than max_age, overlapping and adjacent ranges are joined
+     *
+     * @param dev_addr server address in Modbus application layer
+     * @param ranges requested register ranges
+     * @param max_age maximum age of cached value
+     * @return std::error_code
+     */
+    std::error_code taskReadRegistersCached(const std::uint8_t dev_addr, const std::vector<RegisterRange>& ranges, const std::chrono::milliseconds max_age,
+                                            const bool print_progress = false);
+    /**
+     * @brief get register values from cache
+     *
+     * @param dev_addr server address in Modbus application layer
+     * @param range requested registers
+     * @param max_age maximum age of cached value
+     * @param values reference to vector with registers
+     * @return true if all registers are cached and fresh
+     */
+    bool getCachedRegisters(const std::uint8_t dev_addr, const RegisterRange& range, const std::chrono::milliseconds max_age, std::vector<std::uint16_t>& values);
+    /**
+     * @brief drop all cached values of the server
+     *
+     * @param dev_addr server address in Modbus application layer
+     */
+    void invalidateCache(const std::uint8_t dev_addr);
+    /**
+     * @brief add periodic register group, values are stored in register cache
+     *
+     * @param group server, register range, period and deadline
+     * @return group id, poll_group_not_found if group is invalid
+     */
+    int addPollGroup(const PollGroup& group);
+    /**
+     * @brief remove periodic register group
+     *
+     * @param id group id
+     * @return false if group was not found
+     */
+    bool removePollGroup(const int id);
+    /**
+     * @brief get achieved rate, errors and overruns of the group
+     *
+     * @param id group id
+     * @param statistics reference to statistics
+     * @return false if group was not found
+     */
+    bool getPollStatistics(const int id, PollStatistics& statistics) const;
+    /**
+     * @brief start polling in client thread, poll frames are sent while no task is queued
+     *
+     * servers must be added before polling is started
+     */
+    void startPolling();
+    void stopPolling() { polling.store(false, std::memory_order_relaxed); }
+    /**
+     * @brief get callback when registers in range change by more than deadband, values come from polling and register tasks
+     *
+     * @param subscription server, register range, deadbands and callback called in client thread
+     * @return subscription id, subscription_not_found if subscription is invalid
+     */
+    int subscribe(const Subscription& subscription) { return subscriptions.subscribe(subscription); }
+    bool unsubscribe(const int id) { return subscriptions.unsubscribe(id); }
     /**
      * @brief read file from the server
      *
@@ -176,6 +289,19 @@ public:
      * @return std::error_code
      */
     std::error_code taskReadFile(const std::uint8_t dev_addr, const std::uint16_t file_id, const std::size_t file_size, const bool print_progress = false);
+    /**
+     * @brief read file from the server, every record is passed to the sink as soon as it is received
+     *
+     * memory usage does not depend on file size, file.getData() stays empty
+     *
+     * @param dev_addr server address in Modbus application layer
+     * @param file_id file id in Modbus application layer
+     * @param file_size expected file size
+     * @param sink record receiver, see File::makeDriveSink()
+     * @return std::error_code
+     */
+    std::error_code taskReadFile(const std::uint8_t dev_addr, const std::uint16_t file_id, const std::size_t file_size, RecordSink sink,
+                                 const bool print_progress = false);
     /**
      * @brief write file to the server
      *
@@ -183,6 +309,50 @@ public:
      * @return std::error_code
      */
     std::error_code taskWriteFile(const std::uint8_t dev_addr, const bool print_progress = false);
+    /**
+     * @brief compare file digest computed by the server during the last write with digest of the local file
+     *
+     * @param dev_addr server address in Modbus application layer
+     * @return std::error_code ClientErrors::digest_mismatch if file on the server is different
+     */
+    std::error_code taskVerifyFile(const std::uint8_t dev_addr, const bool print_progress = false);
+    /**
+     * @brief write file to all servers on the bus with broadcast requests, then read received records map
+     * from every server and write missing records to it
+     *
+     * record size of the file must be even and supported by every server
+     *
+     * @param dev_addrs servers which should receive the file
+     * @param baudrate bus speed in bits per second, broadcast requests are paced by the frame time
+     * @param results result for every server in dev_addrs order
+     * @param processing_time time required by the slowest server to process one broadcast request
+     * @return std::error_code error of the broadcast stage
+     */
+    std::error_code taskBroadcastFile(const std::vector<std::uint8_t>& dev_addrs, const std::uint32_t baudrate, std::vector<std::error_code>& results,
+                                      const std::chrono::microseconds processing_time = std::chrono::microseconds(default_broadcast_processing_us),
+                                      const bool print_progress = false);
+    /**
+     * @brief get counters and latency histograms of all exchanges since the client was created
+     *
+     * @return MetricsSnapshot
+     */
+    MetricsSnapshot getMetrics() const { return metrics.snapshot(); }
+    /**
+     * @brief write metrics in Prometheus text format, see ClientMetrics::writePrometheus()
+     *
+     * @param path path to file
+     * @return false if file can not be written
+     */
+    bool writeMetrics(const std::string& path) const { return metrics.writePrometheus(path); }
+    /**
+     * @brief write every request and response to pcap file until stopCapture() is called, see sm_pcap.hpp for the format
+     *
+     * @param path path to file, existing file is replaced
+     * @return false if file can not be created
+     */
+    bool startCapture(const std::string& path) { return capture.start(path); }
+    void stopCapture() { capture.stop(); }
+    CaptureStatistics getCaptureStatistics() const { return capture.getStatistics(); }
     /**
      * @brief Get the actual task progress
      *
@@ -217,21 +387,78 @@ public:
 private:
     std::vector<std::uint8_t> request_data;
     std::vector<std::uint8_t> response_data;
+    // file record of the actual exchange, last record is padded to the record size
+    std::vector<std::uint8_t> record_data;
+    // content of FileDefinitions::record_map read from the server
+    std::vector<std::uint8_t> record_map;
+    // pacing of broadcast requests of the actual taskBroadcastFile()
+    std::uint32_t broadcast_baudrate = 0;
+    std::chrono::microseconds broadcast_processing_time{default_broadcast_processing_us};
     modbus::ModbusMessage modbus_message = modbus::ModbusMessage(modbus::ModbusMode::rtu);
-    std::vector<ServerData> servers;
-    std::thread client_thread;
+    // deque keeps references valid while servers are added
+    std::deque<ServerData> servers;
+    // protects the servers container and ServerInfo of every server, taken before cache_mutex
+    mutable std::mutex servers_mutex;
     std::atomic<bool> thread_stop{false};
     std::future<void> task;
     TaskInfo task_info{ClientTasks::undefined, 0, -1};
+    // filled and drained in client thread only
     std::queue<std::function<void()>> q_exchange;
-    std::queue<std::function<void()>> q_task;
+    // holds at most one task, task methods are serialized by api_mutex and wait for completion
+    std::queue<std::function<void()>> q_task; // protected by wait_mutex
+    // task methods may be called from several threads and call each other (file transfer setup)
+    std::recursive_mutex api_mutex;
+    // protects task queue and wake up flag, task state is not protected by it
+    std::mutex wait_mutex;
+    std::condition_variable client_wake_up; // new task, new poll group or polling started
+    bool wake_up_requested = false;         // protected by wait_mutex
+    std::condition_variable task_completed;
+    PollScheduler poll_scheduler;
+    std::atomic<bool> polling{false};
+    SubscriptionSet subscriptions;
+    // cache is updated in client thread and read by the application
+    std::mutex cache_mutex;
+    // recorded in client thread, read by the application at any time
+    ClientMetrics metrics;
+    // filled in client thread, written to file by its own thread
+    FrameCapture capture;
+    // started in constructor, must be declared after everything used by clientThread()
+    std::thread client_thread;
     /**
-     * @brief get server index in internal vector with servers
+     * @brief get server index in internal list of servers
      *
      * @param dev_addr server address in Modbus application layer
      * @return int index in servers array, server_not_found if server not exist
      */
     int getServerIndex(const std::uint8_t dev_addr) const;
+    /**
+     * @brief same as getServerIndex, servers_mutex must be held by the caller
+     *
+     * @param dev_addr server address in Modbus application layer
+     * @return int index in servers array, server_not_found if server not exist
+     */
+    int findServerIndex(const std::uint8_t dev_addr) const;
+    /**
+     * @brief get server by index, ServerInfo must be accessed with getServerInfo() and setServerStatus()
+     *
+     * @param index server index in servers array
+     * @return reference which stays valid while other servers are added
+     */
+    ServerData& getServer(const int index);
+    /**
+     * @brief get copy of the server information
+     *
+     * @param index server index in servers array
+     * @return ServerInfo
+     */
+    ServerInfo getServerInfo(const int index) const;
+    /**
+     * @brief update server status
+     *
+     * @param index server index in servers array
+     * @param status new status
+     */
+    void setServerStatus(const int index, const ServerStatus status);
     /**
      * @brief get expected server response length
      *
@@ -240,6 +467,105 @@ private:
      * @return size in bytes
      */
     size_t getExpectedLength(const ClientTasks task, const size_t extra = 0) const;
+    /**
+     * @brief write expected response length to the gateway of the routed server before the exchange, write is skipped if gateway
+     * already has this value, called by client thread only
+     *
+     * @param dev_addr server address in Modbus application layer
+     * @param expected_length expected server response length
+     * @return false if gateway is not connected or did not accept the value
+     */
+    bool prepareGateway(const std::uint8_t dev_addr, const size_t expected_length);
+    /**
+     * @brief forget gateway buffer size of the server gateway and of the server itself
+     *
+     * @param index server index in servers array
+     */
+    void resetGatewayState(const int index);
+    /**
+     * @brief write selected records of the file, transfer must be already prepared on the server
+     *
+     * @param index server index in servers array
+     * @param records record indexes in the file
+     * @param file_control value for transfer setup of every next segment, 0 if records are in the selected segment
+     * @return std::error_code
+     */
+    std::error_code writeRecords(const int index, const std::vector<std::uint32_t>& records, const std::uint16_t file_control = 0,
+                                 const bool print_progress = false);
+    /**
+     * @brief read received records map of the actual transfer from the server
+     *
+     * @param index server index in servers array
+     * @param segment selected segment
+     * @param missing indexes of file records which were not received by the server
+     * @return std::error_code
+     */
+    std::error_code readMissingRecords(const int index, const std::uint32_t segment, std::vector<std::uint32_t>& missing);
+    /**
+     * @brief write segment registers of the server, exception is ignored if the file fits in one segment
+     *
+     * @param dev_addr server address in Modbus application layer
+     * @param segment segment to select
+     * @return std::error_code
+     */
+    std::error_code selectSegment(const std::uint8_t dev_addr, const std::uint32_t segment);
+    /**
+     * @brief write record size and record counter of the first segment, then file control
+     *
+     * @param dev_addr server address in Modbus application layer
+     * @param file_control file_read_prepare or file_write_prepare
+     * @param record_size record size of the transfer
+     * @return std::error_code
+     */
+    std::error_code writeTransferSetup(const std::uint8_t dev_addr, const std::uint16_t file_control, const std::uint8_t record_size);
+    /**
+     * @brief add segment selection and transfer setup of the segment to the actual task
+     *
+     * @param dev_addr server address in Modbus application layer, broadcast address is allowed
+     * @param segment segment to select
+     * @param file_control file_read_prepare or file_write_prepare
+     */
+    void pushTransferSetup(const std::uint8_t dev_addr, const std::uint32_t segment, const std::uint16_t file_control);
+    /**
+     * @brief add block write of registers to the actual task
+     *
+     * @param dev_addr server address in Modbus application layer, broadcast address is allowed
+     * @param reg_addr register start address in Modbus application layer
+     * @param values new register values
+     */
+    void pushRegistersWrite(const std::uint8_t dev_addr, const std::uint16_t reg_addr, const std::vector<std::uint16_t>& values);
+    /**
+     * @brief take file record from the image to record_data, throws std::system_error if image can not be read
+     *
+     * @param index record index
+     */
+    void loadRecord(const std::uint32_t index);
+    /**
+     * @brief get time to keep the bus silent after broadcast request
+     *
+     * @param length request length in bytes
+     * @param baudrate bus speed in bits per second
+     * @param processing_time time required by the server to process the request
+     * @return transmit time, 3.5 characters of silence and processing time
+     */
+    static std::chrono::microseconds getBroadcastPause(const size_t length, const std::uint32_t baudrate, const std::chrono::microseconds processing_time);
+    /**
+     * @brief pass task to client thread and wait until it is completed
+     *
+     * @param function task which fills q_exchange
+     * @return std::error_code
+     */
+    std::error_code executeTask(std::function<void()>&& function);
+    /**
+     * @brief wake up client thread sleeping until the next poll release
+     *
+     */
+    void wakeUpClient();
+    /**
+     * @brief mark actual task as completed and wake up waiting task method
+     *
+     */
+    void completeTask();
     /**
      * @brief handler for client_thread
      *
@@ -267,6 +593,37 @@ private:
      * @param message received message with record
      */
     void fileReadCallback(std::vector<std::uint8_t>& message);
+    /**
+     * @brief store values in the server cache and report changes to subscribers
+     *
+     */
+    void updateCache(ServerData& server, const std::uint16_t start, const std::vector<std::uint16_t>& values);
+    /**
+     * @brief mark registers written by the request as stale in the cache of the addressed server or of all servers for broadcast
+     *
+     * @param request request with function write_reg, write_regs or read_write_regs, other requests are ignored
+     */
+    void invalidateWrittenRange(const std::vector<std::uint8_t>& request);
+    /**
+     * @brief execute one released poll frame
+     *
+     * @return false if nothing was released
+     */
+    bool pollTask();
+    /**
+     * @brief request/response exchange in client thread without task state
+     *
+     * @return true if response has expected length and valid checksum
+     */
+    bool directExchange(const std::vector<std::uint8_t>& request, const size_t expected_length, std::vector<std::uint8_t>& response);
+    /**
+     * @brief pass finished exchange to metrics and frame capture
+     *
+     * @param expected_length expected response length, 0 for broadcast request
+     * @param begin time when request write was started
+     */
+    void recordExchange(const std::vector<std::uint8_t>& request, const std::vector<std::uint8_t>& response, const size_t expected_length,
+                        const MetricsClock::time_point begin);
     /**
      * @brief print task progress to stdout
      * 
@@ -26,6 +26,9 @@ enum class ClientErrors
     gateway_not_connected,
     file_buffer_is_empty,
     max_record_length_not_configured,
+    records_missing,
+    digest_mismatch,
+    file_read_failed,
     internal
 };
 
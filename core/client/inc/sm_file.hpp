@@ -10,12 +10,22 @@
 #ifndef SM_FILE_H
 #define SM_FILE_H
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <string>
 #include <vector>
+#include "sm_image.hpp"
 
 namespace sm
 {
+// gets every record of the file read as soon as it is received, offset is the record position in the file
+// false stops the read with an error
+using RecordSink = std::function<bool(const size_t offset, const std::uint8_t* data, const size_t length)>;
+// segment is selected with 16 bit register, every segment has up to modbus::max_num_of_records records
+constexpr std::uint32_t max_num_of_segments = 0xFFFF;
+
 class File
 {
 public:
@@ -23,13 +33,30 @@ public:
 
     bool fileReadSetup(const std::uint16_t id, const size_t file_size, const std::uint8_t record_size);
 
+    // records are passed to the sink instead of RAM buffer, getData() stays empty
+    bool fileReadSetup(const std::uint16_t id, const size_t file_size, const std::uint8_t record_size, RecordSink sink);
+
+    // sink writes and flushes every record to the file on disk, empty sink if file can not be created
+    static RecordSink makeDriveSink(const std::string path_to_file);
+
     bool fileWriteSetupFromDrive(const std::uint16_t id, const std::string path_to_file, const std::uint8_t record_size);
 
     bool fileWriteSetupFromMemory(const std::uint16_t id, const std::vector<std::uint8_t>& file_data, const std::uint8_t record_size);
 
-    std::uint16_t getActualRecordLength(const int index) const;
+    // image is not copied, the same buffer may be used by several clients at once
+    bool fileWriteSetupShared(const std::uint16_t id, std::shared_ptr<const std::vector<std::uint8_t>> image, const std::uint8_t record_size);
+
+    // records are taken from the source right before they are sent, the same source may be used by several clients at once
+    bool fileWriteSetup(const std::uint16_t id, std::shared_ptr<const ImageSource> source, const std::uint8_t record_size);
+
+    std::uint16_t getActualRecordLength(const std::uint32_t index) const;
+
+    std::uint32_t getNumOfRecords() const { return num_of_records; };
 
-    std::uint16_t getNumOfRecords() const { return num_of_records; };
+    // files with more than modbus::max_num_of_records records are transferred in several segments
+    std::uint32_t getNumOfSegments() const;
+
+    std::uint16_t getSegmentRecords(const std::uint32_t segment) const;
 
     bool getRecordFromMessage(const std::vector<std::uint8_t>& message);
 
@@ -37,20 +64,32 @@ public:
 
     std::uint8_t* getData() const { return data.get(); }
 
+    // record as it is sent to the server, last record is padded with 0xFF to the record size
+    bool getRecord(const std::uint32_t index, std::vector<std::uint8_t>& record) const;
+
+    size_t getSize() const { return file_size; }
+
     std::uint16_t getId() const { return id; }
 
+    std::uint8_t getRecordSize() const { return record_size; }
+
+    // CRC32 of all records as they are written to the server, last record is padded with 0xFF
+    std::uint32_t getDigest() const;
+
     size_t getFileSize(const std::string path_to_file) const;
 
 private:
     std::unique_ptr<std::uint8_t[]> data;
+    std::shared_ptr<const ImageSource> source;
+    RecordSink sink;
     size_t file_size = 0;
-    std::uint16_t num_of_records = 0;
-    std::uint16_t counter = 0;
+    std::uint32_t num_of_records = 0;
+    std::uint32_t counter = 0;
     std::uint16_t id = 0;
     std::uint8_t record_size = 0;
     bool ready = false;
 
-    std::uint16_t calcNumOfRecords(const size_t file_size) const;
+    std::uint32_t calcNumOfRecords(const size_t file_size) const;
 };
 } // namespace sm
 
@@ -0,0 +1,131 @@
+/**
+ * @file sm_fleet.hpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#ifndef SM_FLEET_H
+#define SM_FLEET_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "../../common/sm_common.hpp"
+#include "../../external/simple-serial-port/inc/serial_port.hpp"
+#include "sm_image.hpp"
+
+namespace sm
+{
+
+class ModbusClient;
+
+using FleetImage = std::shared_ptr<const ImageSource>;
+
+struct FleetJob
+{
+    std::string port;
+    std::uint8_t dev_addr = 0;
+    std::uint8_t gateway_addr = 0;
+    FleetImage image; // shared between jobs, never modified
+    std::uint16_t file_id = FileDefinitions::application;
+};
+
+enum class FleetJobState
+{
+    pending,
+    running,
+    done,
+    failed
+};
+
+struct FleetJobResult
+{
+    FleetJob job;
+    FleetJobState state = FleetJobState::pending;
+    std::error_code error_code;
+    std::uint8_t record_size = 0;
+    std::chrono::milliseconds duration{0};
+};
+
+struct FleetProgress
+{
+    size_t total = 0;
+    size_t running = 0;
+    size_t done = 0;
+    size_t failed = 0;
+    int progress = 0; // from task_not_started_value to task_complete_value, running jobs are counted with their own progress
+};
+
+class FleetUpdater
+{
+public:
+    FleetUpdater(const sp::PortConfig& config) : config(config) {}
+    ~FleetUpdater();
+    FleetUpdater(const FleetUpdater&) = delete;
+    FleetUpdater& operator=(const FleetUpdater&) = delete;
+    /**
+     * @brief map image once, result can be used by any amount of jobs
+     *
+     * @param path path to image file
+     * @return empty pointer if file can not be read
+     */
+    static FleetImage loadImage(const std::string& path);
+    /**
+     * @brief add device to update, jobs of the same port are executed in the order they were added
+     *
+     * @param job port, server address, optional gateway address and image
+     */
+    void addJob(const FleetJob& job);
+    /**
+     * @brief update devices of the same port without gateway and with the same image by one broadcast transfer
+     *
+     * @param baudrate bus speed in bits per second used to pace broadcast requests, 0 disables broadcast
+     */
+    void setBroadcast(const std::uint32_t baudrate) { broadcast_baudrate = baudrate; }
+    /**
+     * @brief start one worker thread with own client for every port
+     *
+     */
+    void start();
+    /**
+     * @brief wait until all jobs are completed
+     *
+     */
+    void wait();
+    FleetProgress getProgress() const;
+    std::vector<FleetJobResult> getResults() const;
+
+private:
+    struct PortWorker
+    {
+        std::string port;
+        std::vector<size_t> jobs; // indices in results
+        std::unique_ptr<ModbusClient> client;
+        std::atomic<bool> transferring{false}; // client task progress belongs to the running job
+        std::thread thread;
+    };
+    sp::PortConfig config;
+    std::uint32_t broadcast_baudrate = 0;
+    mutable std::mutex results_mutex;
+    std::vector<FleetJobResult> results;
+    std::vector<std::unique_ptr<PortWorker>> workers;
+    void portTask(PortWorker& worker);
+    std::error_code updateDevice(PortWorker& worker, FleetJobResult& result);
+    void updateGroup(PortWorker& worker, const std::vector<size_t>& group);
+    std::error_code prepareDevice(ModbusClient& client, const FleetJob& job, std::uint8_t& record_size);
+    void setState(const size_t index, const FleetJobState state, const std::error_code& error_code);
+};
+
+} // namespace sm
+
+#endif // SM_FLEET_H
@@ -0,0 +1,97 @@
+/**
+ * @file sm_image.hpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#ifndef SM_IMAGE_H
+#define SM_IMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sm
+{
+
+// data of the file to write, records are taken from it on demand right before they are sent
+class ImageSource
+{
+public:
+    virtual ~ImageSource() = default;
+    virtual size_t size() const = 0;
+    /**
+     * @brief copy part of the image, may be called from several clients at once
+     *
+     * @param offset position in the image
+     * @param data destination
+     * @param length amount of bytes, offset + length never exceeds size()
+     * @return false if data is not available
+     */
+    virtual bool read(const size_t offset, std::uint8_t* data, const size_t length) const = 0;
+};
+
+// image memory is borrowed, owner (if any) keeps it alive while the image is used
+class MemoryImage : public ImageSource
+{
+public:
+    MemoryImage(const std::uint8_t* data, const size_t length, std::shared_ptr<const void> owner = nullptr)
+        : data(data), length(length), owner(std::move(owner)) {}
+    size_t size() const override { return length; }
+    bool read(const size_t offset, std::uint8_t* data, const size_t length) const override;
+
+private:
+    const std::uint8_t* data;
+    const size_t length;
+    std::shared_ptr<const void> owner;
+};
+
+// file mapped to memory, nothing is read until records are sent
+class MappedImage : public ImageSource
+{
+public:
+    /**
+     * @brief map file to memory
+     *
+     * @param path path to file
+     * @return empty pointer if file can not be opened or is empty
+     */
+    static std::shared_ptr<MappedImage> open(const std::string& path);
+    ~MappedImage() override;
+    MappedImage(const MappedImage&) = delete;
+    MappedImage& operator=(const MappedImage&) = delete;
+    size_t size() const override { return length; }
+    bool read(const size_t offset, std::uint8_t* data, const size_t length) const override;
+
+private:
+    MappedImage() = default;
+    const std::uint8_t* data = nullptr;
+    size_t length = 0;
+    // platforms without mmap keep the file content here
+    std::vector<std::uint8_t> buffer;
+};
+
+// image generated on the fly, producer is called with the same arguments as read()
+// and must be able to return any part of the image again (missing records, digest)
+class StreamImage : public ImageSource
+{
+public:
+    using Producer = std::function<bool(const size_t offset, std::uint8_t* data, const size_t length)>;
+    StreamImage(const size_t length, Producer producer) : length(length), producer(std::move(producer)) {}
+    size_t size() const override { return length; }
+    bool read(const size_t offset, std::uint8_t* data, const size_t length) const override { return producer && producer(offset, data, length); }
+
+private:
+    const size_t length;
+    Producer producer;
+};
+
+} // namespace sm
+
+#endif // SM_IMAGE_H
@@ -42,6 +42,11 @@ public:
 
     void msgReadRegisters(std::vector<std::uint8_t>& buffer, const std::uint16_t reg, const std::uint16_t quantity, const std::uint8_t addr = 0);
 
+    void msgWriteRegisters(std::vector<std::uint8_t>& buffer, const std::uint16_t reg, const std::vector<std::uint16_t>& values, const std::uint8_t addr = 0);
+
+    void msgReadWriteRegisters(std::vector<std::uint8_t>& buffer, const std::uint16_t read_reg, const std::uint16_t quantity, const std::uint16_t write_reg,
+                               const std::vector<std::uint16_t>& values, const std::uint8_t addr = 0);
+
     bool isChecksumValid(const std::vector<std::uint8_t>& data) const;
 
     bool extractData(const std::vector<std::uint8_t>& buffer, std::vector<std::uint8_t>& pdu) const;
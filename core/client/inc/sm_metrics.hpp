@@ -0,0 +1,174 @@
+/**
+ * @file sm_metrics.hpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#ifndef SM_METRICS_H
+#define SM_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "../../common/sm_modbus.hpp"
+
+namespace sm
+{
+
+using MetricsClock = std::chrono::steady_clock;
+
+enum class ExchangeResult
+{
+    success,
+    broadcast, // no response is expected
+    timeout,   // nothing received
+    crc_error, // response with invalid checksum
+    exception, // valid response with unexpected length, exception or gateway error
+};
+
+struct HistogramSnapshot
+{
+    std::vector<std::uint64_t> buckets; // counts in LatencyHistogram buckets
+    std::uint64_t count = 0;
+    std::uint64_t sum_us = 0;
+    std::uint64_t max_us = 0;
+    /**
+     * @brief get value below which the given part of samples falls
+     *
+     * @param quantile value from 0.0 to 1.0
+     * @return upper bound of the bucket in microseconds, 0 if histogram is empty
+     */
+    std::uint64_t getQuantile(const double quantile) const;
+    /**
+     * @brief count of samples with value up to the limit, precision is limited by bucket width
+     *
+     */
+    std::uint64_t getCountBelow(const std::uint64_t limit_us) const;
+    void merge(const HistogramSnapshot& other);
+};
+
+// log-linear buckets like in HdrHistogram: values below 32 us are exact, above them every power of two
+// is split into 16 buckets, so relative error stays below 6.25% up to about 71 minutes
+class LatencyHistogram
+{
+public:
+    static constexpr unsigned sub_bucket_bits = 4;
+    static constexpr std::uint64_t max_value_us = 0xFFFFFFFF;
+    static constexpr size_t num_of_buckets = (2U << sub_bucket_bits) + ((32 - sub_bucket_bits - 1) << sub_bucket_bits);
+    /**
+     * @brief add sample, never blocks and never allocates
+     *
+     * @param value_us value in microseconds, larger values are clamped to max_value_us
+     */
+    void record(const std::uint64_t value_us);
+    HistogramSnapshot snapshot() const;
+    static size_t getBucketIndex(const std::uint64_t value_us);
+    static std::uint64_t getBucketUpperBound(const size_t index);
+
+private:
+    std::array<std::atomic<std::uint64_t>, num_of_buckets> buckets{};
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<std::uint64_t> sum_us{0};
+    std::atomic<std::uint64_t> max_us{0};
+};
+
+struct ExchangeStatistics
+{
+    std::uint64_t frames_sent = 0;
+    std::uint64_t frames_received = 0;
+    std::uint64_t bytes_sent = 0;
+    std::uint64_t bytes_received = 0;
+    std::uint64_t broadcasts = 0;
+    std::uint64_t timeouts = 0;
+    std::uint64_t crc_errors = 0;
+    std::uint64_t exceptions = 0;
+    std::chrono::microseconds busy_time{0}; // from request write to the end of response, pause or timeout
+    void merge(const ExchangeStatistics& other);
+};
+
+struct ServerMetrics
+{
+    ExchangeStatistics statistics;
+    std::map<std::uint8_t, HistogramSnapshot> latency; // function code of the request is the key
+};
+
+struct MetricsSnapshot
+{
+    std::chrono::microseconds elapsed{0}; // time since client was created, rates are averaged over it
+    ExchangeStatistics total;
+    double frames_per_second = 0.0;
+    double bytes_per_second = 0.0;
+    double bus_utilization = 0.0; // part of elapsed time spent in exchanges, from 0.0 to 1.0
+    std::map<std::uint8_t, ServerMetrics> servers;       // server address is the key, 0 for broadcast requests
+    std::map<std::uint8_t, HistogramSnapshot> functions; // latency of all servers by function code
+    /**
+     * @brief format metrics in Prometheus text exposition format
+     *
+     */
+    std::string toPrometheus() const;
+};
+
+// every exchange of the client is recorded here, tasks and polling alike. Recording is lock-free,
+// storage of the server or function code is allocated on its first exchange only
+class ClientMetrics
+{
+public:
+    ClientMetrics() = default;
+    ~ClientMetrics();
+    ClientMetrics(const ClientMetrics&) = delete;
+    ClientMetrics& operator=(const ClientMetrics&) = delete;
+    /**
+     * @brief record finished exchange
+     *
+     * @param address server address of the request
+     * @param function function code of the request
+     * @param bytes_sent request length
+     * @param bytes_received response length, 0 if nothing was received
+     * @param result result of the exchange
+     * @param duration time from request write to the end of response, pause or timeout
+     */
+    void recordExchange(const std::uint8_t address, const std::uint8_t function, const size_t bytes_sent, const size_t bytes_received,
+                        const ExchangeResult result, const std::chrono::microseconds duration);
+    MetricsSnapshot snapshot() const;
+    /**
+     * @brief write snapshot in Prometheus text format, file is replaced at once so collector never reads partial file
+     *
+     * @param path path to file, usually in node exporter textfile collector directory
+     * @return false if file can not be written
+     */
+    bool writePrometheus(const std::string& path) const;
+
+private:
+    struct Counters
+    {
+        std::atomic<std::uint64_t> frames_sent{0};
+        std::atomic<std::uint64_t> frames_received{0};
+        std::atomic<std::uint64_t> bytes_sent{0};
+        std::atomic<std::uint64_t> bytes_received{0};
+        std::atomic<std::uint64_t> broadcasts{0};
+        std::atomic<std::uint64_t> timeouts{0};
+        std::atomic<std::uint64_t> crc_errors{0};
+        std::atomic<std::uint64_t> exceptions{0};
+        std::atomic<std::uint64_t> busy_us{0};
+    };
+    struct ServerSlot
+    {
+        Counters counters;
+        std::array<std::atomic<LatencyHistogram*>, 256> functions{};
+    };
+    const MetricsClock::time_point created = MetricsClock::now();
+    std::array<std::atomic<ServerSlot*>, modbus::max_rtu_address + 1> servers{};
+    template <typename T> static T& getSlot(std::atomic<T*>& slot);
+};
+
+} // namespace sm
+
+#endif // SM_METRICS_H
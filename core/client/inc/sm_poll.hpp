@@ -0,0 +1,102 @@
+/**
+ * @file sm_poll.hpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#ifndef SM_POLL_H
+#define SM_POLL_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include "../inc/sm_cache.hpp"
+
+namespace sm
+{
+
+using PollClock = std::chrono::steady_clock;
+
+constexpr int poll_group_not_found = -1;
+
+struct PollGroup
+{
+    std::uint8_t dev_addr = 0;
+    RegisterRange range;
+    std::chrono::milliseconds period{1000};
+    std::chrono::milliseconds deadline{0}; // relative to release, zero means equal to period
+};
+
+struct PollStatistics
+{
+    std::uint64_t releases = 0;  // how many times group became due
+    std::uint64_t completed = 0; // successful reads
+    std::uint64_t errors = 0;    // failed reads
+    std::uint64_t overruns = 0;  // reads finished after deadline or skipped releases
+    std::chrono::microseconds max_lateness{0};
+    double achieved_rate = 0.0;  // completed reads per second since group was added
+};
+
+// registers of several groups read in one request
+struct PollFrame
+{
+    std::uint8_t dev_addr = 0;
+    RegisterRange range;
+    std::vector<int> groups;
+};
+
+class PollScheduler
+{
+public:
+    /**
+     * @brief add new periodic group, first release is immediate
+     *
+     * @return group id
+     */
+    int addGroup(const PollGroup& group, const PollClock::time_point now = PollClock::now());
+    bool removeGroup(const int id);
+    void clear();
+    bool getStatistics(const int id, PollStatistics& statistics, const PollClock::time_point now = PollClock::now()) const;
+    /**
+     * @brief get released group with earliest deadline, other released groups of the same server are joined if range stays contiguous
+     *
+     * @return frame to read, empty if nothing is released
+     */
+    std::optional<PollFrame> next(const PollClock::time_point now = PollClock::now());
+    /**
+     * @brief report result of the frame returned by next()
+     *
+     */
+    void complete(const PollFrame& frame, const bool success, const PollClock::time_point now = PollClock::now());
+    /**
+     * @brief time of the next release, PollClock::time_point::max() if there are no groups
+     *
+     */
+    PollClock::time_point getNextRelease() const;
+
+private:
+    struct Job
+    {
+        PollGroup group;
+        PollClock::time_point added;
+        PollClock::time_point release;
+        PollClock::time_point deadline;
+        bool in_progress = false;
+        PollStatistics statistics;
+    };
+    mutable std::mutex m;
+    std::map<int, Job> jobs;
+    int next_id = 0;
+
+    static bool isReleased(const Job& job, const PollClock::time_point now) { return !job.in_progress && (job.release <= now); }
+};
+
+} // namespace sm
+
+#endif // SM_POLL_H
@@ -0,0 +1,79 @@
+/**
+ * @file sm_progress.hpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#ifndef SM_PROGRESS_H
+#define SM_PROGRESS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace sm
+{
+
+constexpr int default_progress_rate_hz = 10;
+
+struct ProgressReport
+{
+    int progress = 0;           // mean progress of all sources, from 0 to 100
+    std::map<int, int> sources; // source id and its progress
+};
+
+// progress of any number of transfers is sampled by own thread and reported to the callback at most rate_hz times
+// per second and only when it changes, threads performing exchanges never wait for the observer
+class ProgressMonitor
+{
+public:
+    // returns progress of the source from 0 to 100, e.g. ModbusClient::getActualTaskProgress()
+    using Sampler = std::function<int()>;
+    using Callback = std::function<void(const ProgressReport&)>;
+    /**
+     * @brief start observer thread
+     *
+     * @param callback called from observer thread
+     * @param rate_hz maximum amount of callback calls per second
+     */
+    explicit ProgressMonitor(Callback callback, const int rate_hz = default_progress_rate_hz);
+    ~ProgressMonitor();
+    ProgressMonitor(const ProgressMonitor&) = delete;
+    ProgressMonitor& operator=(const ProgressMonitor&) = delete;
+    /**
+     * @brief add progress source, sampler must stay valid until the source is removed
+     *
+     * @return source id
+     */
+    int addSource(Sampler sampler);
+    bool removeSource(const int id);
+    /**
+     * @brief sample all sources now
+     *
+     * @return ProgressReport
+     */
+    ProgressReport getReport() const;
+
+private:
+    Callback callback;
+    const std::chrono::milliseconds period;
+    mutable std::mutex sources_mutex;
+    std::map<int, Sampler> sources;
+    int next_id = 0;
+    std::mutex stop_mutex;
+    std::condition_variable stop_request;
+    bool stop = false; // protected by stop_mutex
+    // started in constructor, must be declared last
+    std::thread observer;
+    void observerThread();
+};
+
+} // namespace sm
+
+#endif // SM_PROGRESS_H
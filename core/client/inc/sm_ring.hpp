@@ -0,0 +1,84 @@
+/**
+ * @file sm_ring.hpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#ifndef SM_RING_H
+#define SM_RING_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace sm
+{
+
+constexpr size_t cache_line_size = 64;
+
+// bounded single producer / single consumer queue, push and pop never block and never allocate
+template <typename T, size_t capacity>
+class SpscRing
+{
+    static_assert((capacity != 0) && ((capacity & (capacity - 1)) == 0), "capacity must be a power of two");
+
+public:
+    /**
+     * @brief called by producer only
+     *
+     * @return false if ring is full
+     */
+    bool push(T&& value)
+    {
+        const size_t position = head.load(std::memory_order_relaxed);
+        if ((position - tail_cache) == capacity)
+        {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if ((position - tail_cache) == capacity)
+            {
+                return false;
+            }
+        }
+        slots[position & (capacity - 1)] = std::move(value);
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+    /**
+     * @brief called by consumer only
+     *
+     * @return false if ring is empty
+     */
+    bool pop(T& value)
+    {
+        const size_t position = tail.load(std::memory_order_relaxed);
+        if (position == head_cache)
+        {
+            head_cache = head.load(std::memory_order_acquire);
+            if (position == head_cache)
+            {
+                return false;
+            }
+        }
+        value = std::move(slots[position & (capacity - 1)]);
+        slots[position & (capacity - 1)] = T();
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+
+private:
+    // producer and consumer indices live on separate cache lines, every side keeps a copy of the other index
+    alignas(cache_line_size) std::atomic<size_t> head{0};
+    size_t tail_cache = 0;
+    alignas(cache_line_size) std::atomic<size_t> tail{0};
+    size_t head_cache = 0;
+    alignas(cache_line_size) std::array<T, capacity> slots;
+};
+
+} // namespace sm
+
+#endif // SM_RING_H
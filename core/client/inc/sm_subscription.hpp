@@ -0,0 +1,72 @@
+/**
+ * @file sm_subscription.hpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#ifndef SM_SUBSCRIPTION_H
+#define SM_SUBSCRIPTION_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "../inc/sm_cache.hpp"
+
+namespace sm
+{
+
+constexpr int subscription_not_found = -1;
+
+struct RegisterChange
+{
+    std::uint16_t address = 0;   // register address in Modbus application layer
+    std::uint16_t old_value = 0; // last reported value, equal to new_value in the first report
+    std::uint16_t new_value = 0;
+};
+
+struct Subscription
+{
+    std::uint8_t dev_addr = 0;
+    RegisterRange range;
+    // change is reported if absolute difference from the last reported value is bigger than deadband,
+    // one value per register, empty vector means that every change is reported
+    std::vector<std::uint16_t> deadbands;
+    // called in client thread with the changes of one server response
+    std::function<void(const std::uint8_t dev_addr, const std::vector<RegisterChange>& changes)> callback;
+};
+
+class SubscriptionSet
+{
+public:
+    int subscribe(const Subscription& subscription);
+    bool unsubscribe(const int id);
+    void clear();
+    /**
+     * @brief compare new values with the last reported ones and call callbacks of changed subscriptions
+     *
+     * @param dev_addr server address in Modbus application layer
+     * @param start register start address in Modbus application layer
+     * @param values new register values
+     */
+    void process(const std::uint8_t dev_addr, const std::uint16_t start, const std::vector<std::uint16_t>& values);
+
+private:
+    struct Entry
+    {
+        Subscription subscription;
+        std::vector<std::uint16_t> reported; // last reported values of the whole range
+        std::vector<bool> known;             // register was reported at least once
+    };
+    std::mutex m;
+    std::map<int, Entry> entries;
+    int next_id = 0;
+};
+
+} // namespace sm
+
+#endif // SM_SUBSCRIPTION_H
@@ -0,0 +1,112 @@
+/**
+ * @file sm_cache.cpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#include "../inc/sm_cache.hpp"
+#include <algorithm>
+
+namespace sm
+{
+
+void RegisterCache::update(const std::uint16_t start, const std::vector<std::uint16_t>& values, const CacheClock::time_point time)
+{
+    auto hint = entries.end();
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        hint = entries.insert_or_assign(hint, static_cast<std::uint16_t>(start + i), Entry{values[i], time, true});
+        ++hint;
+    }
+}
+
+void RegisterCache::invalidate(const RegisterRange& range)
+{
+    auto it = entries.lower_bound(range.start);
+    const std::uint32_t end = static_cast<std::uint32_t>(range.start) + range.quantity;
+    for (; (it != entries.end()) && (it->first < end); ++it)
+    {
+        it->second.valid = false;
+    }
+}
+
+bool RegisterCache::read(const RegisterRange& range, const std::chrono::milliseconds max_age, std::vector<std::uint16_t>& values,
+                         const CacheClock::time_point now) const
+{
+    values.clear();
+    auto it = entries.find(range.start);
+    for (std::uint32_t address = range.start; address < (static_cast<std::uint32_t>(range.start) + range.quantity); ++address, ++it)
+    {
+        if ((it == entries.end()) || (it->first != address) || !it->second.valid || ((now - it->second.updated) > max_age))
+        {
+            values.clear();
+            return false;
+        }
+        values.push_back(it->second.value);
+    }
+    return true;
+}
+
+std::vector<RegisterRange> RegisterCache::getStaleRanges(const std::vector<RegisterRange>& ranges, const std::chrono::milliseconds max_age,
+                                                         const std::uint16_t max_quantity, const CacheClock::time_point now) const
+{
+    // union of requested ranges, only these registers are known to exist on the server
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> spans;
+    for (const auto& range : ranges)
+    {
+        if (range.quantity != 0)
+        {
+            spans.emplace_back(range.start, static_cast<std::uint32_t>(range.start) + range.quantity);
+        }
+    }
+    std::sort(spans.begin(), spans.end());
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> merged;
+    for (const auto& span : spans)
+    {
+        if (!merged.empty() && (span.first <= merged.back().second))
+        {
+            merged.back().second = std::max(merged.back().second, span.second);
+        }
+        else
+        {
+            merged.push_back(span);
+        }
+    }
+    // greedy cover of stale registers inside every span gives minimal amount of requests
+    std::vector<RegisterRange> requests;
+    for (const auto& span : merged)
+    {
+        std::uint32_t address = span.first;
+        while (address < span.second)
+        {
+            if (isFresh(static_cast<std::uint16_t>(address), max_age, now))
+            {
+                ++address;
+                continue;
+            }
+            const std::uint32_t window_end = std::min<std::uint32_t>(address + max_quantity, span.second);
+            std::uint32_t last_stale = address;
+            for (std::uint32_t i = address + 1; i < window_end; ++i)
+            {
+                if (!isFresh(static_cast<std::uint16_t>(i), max_age, now))
+                {
+                    last_stale = i;
+                }
+            }
+            requests.emplace_back(static_cast<std::uint16_t>(address), static_cast<std::uint16_t>(last_stale - address + 1));
+            address = last_stale + 1;
+        }
+    }
+    return requests;
+}
+
+bool RegisterCache::isFresh(const std::uint16_t address, const std::chrono::milliseconds max_age, const CacheClock::time_point now) const
+{
+    auto it = entries.find(address);
+    return (it != entries.end()) && it->second.valid && ((now - it->second.updated) <= max_age);
+}
+
+} // namespace sm
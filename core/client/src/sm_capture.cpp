@@ -0,0 +1,142 @@
+/**
+ * @file sm_capture.cpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#include "../inc/sm_capture.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace sm
+{
+
+bool FrameCapture::start(const std::string& path)
+{
+    std::lock_guard<std::mutex> lk(control_mutex);
+    close();
+    file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    const PcapFileHeader header;
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1)
+    {
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+    if (!ring)
+    {
+        ring = std::make_unique<Ring>();
+    }
+    // frames recorded after the previous stop belong to nobody
+    Frame frame;
+    while (ring->pop(frame))
+    {
+    }
+    wall_base = std::chrono::system_clock::now();
+    steady_base = std::chrono::steady_clock::now();
+    writer_stop = false;
+    writer = std::thread(&FrameCapture::writerThread, this);
+    active.store(true, std::memory_order_release);
+    return true;
+}
+
+void FrameCapture::stop()
+{
+    std::lock_guard<std::mutex> lk(control_mutex);
+    close();
+}
+
+void FrameCapture::close()
+{
+    if (!writer.joinable())
+    {
+        return;
+    }
+    active.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> writer_lk(writer_mutex);
+        writer_stop = true;
+    }
+    writer_wake_up.notify_one();
+    writer.join();
+    drain();
+    std::fclose(file);
+    file = nullptr;
+}
+
+void FrameCapture::record(const CaptureDirection direction, const std::uint8_t* data, const size_t length, const std::chrono::steady_clock::time_point time)
+{
+    if (!active.load(std::memory_order_acquire) || (length == 0))
+    {
+        return;
+    }
+    Frame frame;
+    frame.time = time;
+    frame.direction = direction;
+    frame.length = static_cast<std::uint16_t>(std::min<size_t>(length, 0xFFFF));
+    std::memcpy(frame.data.data(), data, std::min<size_t>(length, frame.data.size()));
+    captured.fetch_add(1, std::memory_order_relaxed);
+    if (!ring->push(std::move(frame)))
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+CaptureStatistics FrameCapture::getStatistics() const
+{
+    CaptureStatistics statistics;
+    statistics.captured = captured.load(std::memory_order_relaxed);
+    statistics.dropped = dropped.load(std::memory_order_relaxed);
+    statistics.written = written.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+void FrameCapture::writerThread()
+{
+    std::unique_lock<std::mutex> lk(writer_mutex);
+    while (!writer_stop)
+    {
+        // exchange thread does not notify, frames are collected periodically
+        writer_wake_up.wait_for(lk, std::chrono::milliseconds(capture_flush_period_ms), [this] { return writer_stop; });
+        lk.unlock();
+        drain();
+        lk.lock();
+    }
+}
+
+void FrameCapture::drain()
+{
+    Frame frame;
+    bool any = false;
+    while (ring->pop(frame))
+    {
+        const auto since_start = std::chrono::duration_cast<std::chrono::nanoseconds>(frame.time - steady_base);
+        const auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(wall_base.time_since_epoch()) + since_start;
+        const std::uint8_t direction = static_cast<std::uint8_t>(frame.direction);
+        const std::uint32_t stored = static_cast<std::uint32_t>(std::min<size_t>(frame.length, frame.data.size()));
+        PcapRecordHeader header;
+        header.seconds = static_cast<std::uint32_t>(wall.count() / 1000000000);
+        header.nanoseconds = static_cast<std::uint32_t>(wall.count() % 1000000000);
+        header.captured_length = stored + 1;
+        header.original_length = static_cast<std::uint32_t>(frame.length) + 1;
+        std::fwrite(&header, sizeof(header), 1, file);
+        std::fwrite(&direction, 1, 1, file);
+        std::fwrite(frame.data.data(), 1, stored, file);
+        written.fetch_add(1, std::memory_order_relaxed);
+        any = true;
+    }
+    if (any)
+    {
+        // file may be copied from the device while capture is running
+        std::fflush(file);
+    }
+}
+
+} // namespace sm
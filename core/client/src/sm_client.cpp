@@ -13,6 +13,7 @@
 #include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <numeric>
 
 #include "../../common/sm_common.hpp"
 #include "../inc/sm_client.hpp"
@@ -23,8 +24,8 @@ namespace sm
 
 int ModbusClient::getActualTaskProgress() const 
 {
-    auto volume = task_info.num_of_exchanges;
-    auto progress = task_info.counter;
+    const int volume = task_info.num_of_exchanges.load(std::memory_order_relaxed);
+    const int progress = task_info.counter.load(std::memory_order_relaxed);
     if((volume > 0) && (progress <= volume))
     {
         return (progress * task_complete_value) / volume;
@@ -36,6 +37,12 @@ int ModbusClient::getActualTaskProgress() const
 }
 
 int ModbusClient::getServerIndex(const std::uint8_t address) const
+{
+    std::lock_guard<std::mutex> lk(servers_mutex);
+    return findServerIndex(address);
+}
+
+int ModbusClient::findServerIndex(const std::uint8_t address) const
 {
     auto it = std::find_if(servers.begin(), servers.end(), [address](const ServerData& server) { return server.info.addr == address; });
     if (it != servers.end())
@@ -48,22 +55,90 @@ int ModbusClient::getServerIndex(const std::uint8_t address) const
     }
 }
 
+ServerData& ModbusClient::getServer(const int index)
+{
+    // references stay valid while other servers are added, only the container itself is protected here
+    std::lock_guard<std::mutex> lk(servers_mutex);
+    return servers[index];
+}
+
+ServerInfo ModbusClient::getServerInfo(const int index) const
+{
+    std::lock_guard<std::mutex> lk(servers_mutex);
+    return servers[index].info;
+}
+
+void ModbusClient::setServerStatus(const int index, const ServerStatus status)
+{
+    std::lock_guard<std::mutex> lk(servers_mutex);
+    servers[index].info.status = status;
+}
+
 void ModbusClient::getLastServerRegList(const std::uint8_t dev_addr, ServerRegisters& registers)
 {
     registers = ServerRegisters();
     auto index = getServerIndex(dev_addr);
     if (index != server_not_found)
     {
-        registers = servers[index].registers;
+        registers = getServer(index).registers;
+    }
+}
+
+bool ModbusClient::getCachedRegisters(const std::uint8_t dev_addr, const RegisterRange& range, const std::chrono::milliseconds max_age,
+                                      std::vector<std::uint16_t>& values)
+{
+    auto index = getServerIndex(dev_addr);
+    if (index != server_not_found)
+    {
+        std::lock_guard<std::mutex> lk(cache_mutex);
+        return getServer(index).cache.read(range, max_age, values);
+    }
+    else
+    {
+        values.clear();
+        return false;
+    }
+}
+
+void ModbusClient::invalidateCache(const std::uint8_t dev_addr)
+{
+    auto index = getServerIndex(dev_addr);
+    if (index != server_not_found)
+    {
+        std::lock_guard<std::mutex> lk(cache_mutex);
+        getServer(index).cache.clear();
     }
 }
 
+int ModbusClient::addPollGroup(const PollGroup& group)
+{
+    auto id = poll_scheduler.addGroup(group);
+    wakeUpClient();
+    return id;
+}
+
+bool ModbusClient::removePollGroup(const int id)
+{
+    return poll_scheduler.removeGroup(id);
+}
+
+void ModbusClient::startPolling()
+{
+    polling.store(true, std::memory_order_relaxed);
+    wakeUpClient();
+}
+
+bool ModbusClient::getPollStatistics(const int id, PollStatistics& statistics) const
+{
+    return poll_scheduler.getStatistics(id, statistics);
+}
+
 bool ModbusClient::setServerAsAvailable(const std::uint8_t dev_addr)
 {
     auto index = getServerIndex(dev_addr);
     if (index != server_not_found)
     {
-        servers[index].info.status = ServerStatus::available;
+        setServerStatus(index, ServerStatus::available);
         return true;
     }
     else
@@ -77,6 +152,7 @@ bool ModbusClient::setServerRecordMaxSize(const std::uint8_t dev_addr, const std
     auto index = getServerIndex(dev_addr);
     if (index != server_not_found)
     {
+        std::lock_guard<std::mutex> lk(servers_mutex);
         servers[index].info.record_size = record_size;
         return true;
     }
@@ -117,7 +193,8 @@ void ModbusClient::printProgressBar(const int task_progress)
 
 void ModbusClient::addServer(const std::uint8_t addr, const std::uint8_t gateway_addr)
 {
-    if (getServerIndex(addr) == server_not_found)
+    std::lock_guard<std::mutex> lk(servers_mutex);
+    if (findServerIndex(addr) == server_not_found)
     {
         servers.push_back(ServerData());
         servers.back().info.addr = addr;
@@ -159,6 +236,7 @@ std::error_code ModbusClient::configure(sp::PortConfig config)
 
 std::error_code ModbusClient::taskPing(const std::uint8_t dev_addr)
 {
+    std::lock_guard<std::recursive_mutex> api_lock(api_mutex);
     auto lambda_ping = [this](const std::uint8_t address)
     {
         std::uint8_t function = static_cast<uint8_t>(modbus::FunctionCodes::undefined);
@@ -174,33 +252,13 @@ std::error_code ModbusClient::taskPing(const std::uint8_t dev_addr)
     {
         return make_error_code(ClientErrors::server_not_connected);
     }
-    // we are trying to reach this server through the gateway, perform gateway setup first
-    if (servers[index].info.gateway_addr != 0)
-    {
-        auto gateway_index = getServerIndex(servers[index].info.gateway_addr);
-        if(servers[gateway_index].info.status == ServerStatus::unavailable)
-        {
-            return make_error_code(ClientErrors::gateway_not_connected);
-        }
-        std::uint16_t expected_length = getExpectedLength(ClientTasks::ping);
-        auto error_code = taskWriteRegister(servers[index].info.gateway_addr, RegisterDefinitions::gateway_buffer_size, expected_length);
-        if (error_code)
-        {
-            return error_code;
-        }
-    }
     task_info.reset(ClientTasks::ping, 1, index);
-    q_task.push([this, lambda_ping, dev_addr]() { q_exchange.push([lambda_ping, dev_addr] { lambda_ping(dev_addr); }); });
-    while (!task_info.done.load(std::memory_order_relaxed))
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(default_task_wait_delay_ms));
-    }
-    return task_info.error_code;
+    return executeTask([this, lambda_ping, dev_addr]() { q_exchange.push([lambda_ping, dev_addr] { lambda_ping(dev_addr); }); });
 }
 
 std::error_code ModbusClient::taskWriteRegister(const std::uint8_t dev_addr, const std::uint16_t reg_addr, const std::uint16_t value, const bool print_progress)
 {
-    static bool recursed = false;
+    std::lock_guard<std::recursive_mutex> api_lock(api_mutex);
     auto lambda_write_reg = [this](const std::uint8_t dev_addr, const std::uint16_t reg_addr, const std::uint16_t value)
     {
         modbus_message.msgWriteRegister(request_data, reg_addr, value, dev_addr);
@@ -213,41 +271,18 @@ std::error_code ModbusClient::taskWriteRegister(const std::uint8_t dev_addr, con
     {
         return make_error_code(ClientErrors::server_not_connected);
     }
-    if (servers[index].info.status == ServerStatus::unavailable)
+    if (getServerInfo(index).status == ServerStatus::unavailable)
     {
         return make_error_code(ClientErrors::server_not_connected);
     }
-    // we are trying to reach this server through the gateway, perform gateway setup first
-    if ((servers[index].info.gateway_addr != 0) && !recursed)
-    {
-        recursed = true;
-        auto gateway_index = getServerIndex(servers[index].info.gateway_addr);
-        if(servers[gateway_index].info.status == ServerStatus::unavailable)
-        {
-            recursed = false;
-            return make_error_code(ClientErrors::gateway_not_connected);
-        }
-        std::uint16_t expected_length = getExpectedLength(ClientTasks::reg_write);
-        auto error_code = taskWriteRegister(servers[index].info.gateway_addr, RegisterDefinitions::gateway_buffer_size, expected_length);
-        if (error_code)
-        {
-            recursed = false;
-            return error_code;
-        }
-    }
     task_info.reset(ClientTasks::reg_write, 1, index, print_progress);
-    q_task.push([this, lambda_write_reg, dev_addr, reg_addr, value]()
-                { q_exchange.push([lambda_write_reg, dev_addr, reg_addr, value] { lambda_write_reg(dev_addr, reg_addr, value); }); });
-    while (!task_info.done.load(std::memory_order_relaxed))
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(default_task_wait_delay_ms));
-    }
-    recursed = false;
-    return task_info.error_code;
+    return executeTask([this, lambda_write_reg, dev_addr, reg_addr, value]()
+                       { q_exchange.push([lambda_write_reg, dev_addr, reg_addr, value] { lambda_write_reg(dev_addr, reg_addr, value); }); });
 }
 
 std::error_code ModbusClient::taskReadRegisters(const std::uint8_t dev_addr, const std::uint16_t reg_addr, const std::uint16_t quantity, const bool print_progress)
 {
+    std::lock_guard<std::recursive_mutex> api_lock(api_mutex);
     auto lambda_read_regs = [this](const std::uint8_t dev_addr, const std::uint16_t reg_addr, const std::uint16_t quantity)
     {
         modbus_message.msgReadRegisters(request_data, reg_addr, quantity, dev_addr);
@@ -261,39 +296,136 @@ std::error_code ModbusClient::taskReadRegisters(const std::uint8_t dev_addr, con
     {
         return make_error_code(ClientErrors::server_not_connected);
     }
-    if (servers[index].info.status == ServerStatus::unavailable)
+    if (getServerInfo(index).status == ServerStatus::unavailable)
     {
         return make_error_code(ClientErrors::server_not_connected);
     }
-    // we are trying to reach this server through the gateway, perform gateway setup first
-    if (servers[index].info.gateway_addr != 0)
+    task_info.reset(ClientTasks::regs_read, 1, index,print_progress);
+    getServer(index).registers.reg_start_address = reg_addr;
+    getServer(index).registers.values.clear();
+    return executeTask([this, lambda_read_regs, dev_addr, reg_addr, quantity]()
+                       { q_exchange.push([lambda_read_regs, dev_addr, reg_addr, quantity] { lambda_read_regs(dev_addr, reg_addr, quantity); }); });
+}
+
+std::error_code ModbusClient::taskWriteRegisters(const std::uint8_t dev_addr, const std::uint16_t reg_addr, const std::vector<std::uint16_t>& values,
+                                                 const bool print_progress)
+{
+    std::lock_guard<std::recursive_mutex> api_lock(api_mutex);
+    auto lambda_write_regs = [this](const std::uint8_t dev_addr, const std::uint16_t reg_addr, const std::vector<std::uint16_t>& values)
     {
-        auto gateway_index = getServerIndex(servers[index].info.gateway_addr);
-        if(servers[gateway_index].info.status == ServerStatus::unavailable)
-        {
-            return make_error_code(ClientErrors::gateway_not_connected);
-        }
-        size_t expected_length = getExpectedLength(ClientTasks::regs_read, quantity * 2);
-        auto error_code = taskWriteRegister(servers[index].info.gateway_addr, RegisterDefinitions::gateway_buffer_size, expected_length);
-        if (error_code)
+        modbus_message.msgWriteRegisters(request_data, reg_addr, values, dev_addr);
+        // in case of success we expect start address and quantity
+        TaskAttributes attr = TaskAttributes(modbus::FunctionCodes::write_regs, getExpectedLength(ClientTasks::regs_write));
+        createServerRequest(attr);
+    };
+    if (values.empty() || (values.size() > modbus::max_amount_of_write_regs))
+    {
+        return make_error_code(ClientErrors::internal);
+    }
+    int index = getServerIndex(dev_addr);
+    if (index == server_not_found)
+    {
+        return make_error_code(ClientErrors::server_not_connected);
+    }
+    if (getServerInfo(index).status == ServerStatus::unavailable)
+    {
+        return make_error_code(ClientErrors::server_not_connected);
+    }
+    task_info.reset(ClientTasks::regs_write, 1, index, print_progress);
+    return executeTask([this, lambda_write_regs, dev_addr, reg_addr, values]()
+                       { q_exchange.push([lambda_write_regs, dev_addr, reg_addr, values] { lambda_write_regs(dev_addr, reg_addr, values); }); });
+}
+
+std::error_code ModbusClient::taskReadWriteRegisters(const std::uint8_t dev_addr, const std::uint16_t write_addr, const std::vector<std::uint16_t>& values,
+                                                     const std::uint16_t read_addr, const std::uint16_t quantity, const bool print_progress)
+{
+    std::lock_guard<std::recursive_mutex> api_lock(api_mutex);
+    auto lambda_read_write_regs = [this](const std::uint8_t dev_addr, const std::uint16_t write_addr, const std::vector<std::uint16_t>& values,
+                                         const std::uint16_t read_addr, const std::uint16_t quantity)
+    {
+        modbus_message.msgReadWriteRegisters(request_data, read_addr, quantity, write_addr, values, dev_addr);
+        // response has the same format as read holding registers response
+        size_t expected_length = getExpectedLength(ClientTasks::regs_read_write, quantity * 2);
+        TaskAttributes attr = TaskAttributes(modbus::FunctionCodes::read_write_regs, expected_length);
+        createServerRequest(attr);
+    };
+    if (values.empty() || (values.size() > modbus::max_amount_of_read_write_regs) || (quantity < modbus::min_amount_of_regs) ||
+        (quantity > modbus::max_amount_of_regs))
+    {
+        return make_error_code(ClientErrors::internal);
+    }
+    int index = getServerIndex(dev_addr);
+    if (index == server_not_found)
+    {
+        return make_error_code(ClientErrors::server_not_connected);
+    }
+    if (getServerInfo(index).status == ServerStatus::unavailable)
+    {
+        return make_error_code(ClientErrors::server_not_connected);
+    }
+    task_info.reset(ClientTasks::regs_read_write, 1, index, print_progress);
+    getServer(index).registers.reg_start_address = read_addr;
+    getServer(index).registers.values.clear();
+    return executeTask([this, lambda_read_write_regs, dev_addr, write_addr, values, read_addr, quantity]()
+                       {
+                           q_exchange.push([lambda_read_write_regs, dev_addr, write_addr, values, read_addr, quantity]
+                                           { lambda_read_write_regs(dev_addr, write_addr, values, read_addr, quantity); });
+                       });
+}
+
+std::error_code ModbusClient::taskReadRegistersCached(const std::uint8_t dev_addr, const std::vector<RegisterRange>& ranges,
+                                                      const std::chrono::milliseconds max_age, const bool print_progress)
+{
+    std::lock_guard<std::recursive_mutex> api_lock(api_mutex);
+    auto lambda_read_regs = [this](const std::uint8_t dev_addr, const int index, const RegisterRange range)
+    {
+        // start address is used to place the response in cache
+        getServer(index).registers.reg_start_address = range.start;
+        modbus_message.msgReadRegisters(request_data, range.start, range.quantity, dev_addr);
+        size_t expected_length = getExpectedLength(ClientTasks::regs_read, range.quantity * 2);
+        TaskAttributes attr = TaskAttributes(modbus::FunctionCodes::read_regs, expected_length);
+        createServerRequest(attr);
+    };
+
+    auto lambda_read_ranges = [this, lambda_read_regs, print_progress](const std::uint8_t dev_addr, const int index, const std::vector<RegisterRange>& requests)
+    {
+        task_info.reset(ClientTasks::regs_read, static_cast<int>(requests.size()), index, print_progress);
+        for (const auto& range : requests)
         {
-            return error_code;
+            q_exchange.push([lambda_read_regs, dev_addr, index, range] { lambda_read_regs(dev_addr, index, range); });
         }
+    };
+    int index = getServerIndex(dev_addr);
+    if (index == server_not_found)
+    {
+        return make_error_code(ClientErrors::server_not_connected);
     }
-    task_info.reset(ClientTasks::regs_read, 1, index,print_progress);
-    servers[index].registers.reg_start_address = reg_addr;
-    servers[index].registers.values.clear();
-    q_task.push([this, lambda_read_regs, dev_addr, reg_addr, quantity]()
-                { q_exchange.push([lambda_read_regs, dev_addr, reg_addr, quantity] { lambda_read_regs(dev_addr, reg_addr, quantity); }); });
-    while (!task_info.done.load(std::memory_order_relaxed))
+    if (getServerInfo(index).status == ServerStatus::unavailable)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(default_task_wait_delay_ms));
+        return make_error_code(ClientErrors::server_not_connected);
     }
-    return task_info.error_code;
+    std::vector<RegisterRange> requests;
+    {
+        std::lock_guard<std::mutex> lk(cache_mutex);
+        requests = getServer(index).cache.getStaleRanges(ranges, max_age, modbus::max_amount_of_regs);
+    }
+    if (requests.empty())
+    {
+        return std::error_code();
+    }
+    task_info.reset();
+    return executeTask([dev_addr, index, lambda_read_ranges, requests]() { lambda_read_ranges(dev_addr, index, requests); });
 }
 
 std::error_code ModbusClient::taskReadFile(const std::uint8_t dev_addr, const std::uint16_t file_id, const std::size_t file_size, const bool print_progress)
 {
+    return taskReadFile(dev_addr, file_id, file_size, RecordSink(), print_progress);
+}
+
+std::error_code ModbusClient::taskReadFile(const std::uint8_t dev_addr, const std::uint16_t file_id, const std::size_t file_size, RecordSink sink,
+                                           const bool print_progress)
+{
+    std::lock_guard<std::recursive_mutex> api_lock(api_mutex);
     auto lambda_read_record = [this](const std::uint8_t dev_addr, const std::uint16_t file_id, const std::uint16_t record_id, const std::uint16_t length)
     {
         modbus_message.msgReadFileRecord(request_data, file_id, record_id, length, dev_addr);
@@ -306,107 +438,76 @@ std::error_code ModbusClient::taskReadFile(const std::uint8_t dev_addr, const st
 
     auto lambda_read_file = [this, lambda_read_record, print_progress](const std::uint8_t dev_addr, const int index, const std::uint16_t file_id)
     {
-        const std::uint16_t num_of_records = file.getNumOfRecords();
-        task_info.reset(ClientTasks::file_read, num_of_records, index, print_progress);
-        for (std::uint16_t i = 0; i < num_of_records; ++i)
+        const std::uint32_t num_of_records = file.getNumOfRecords();
+        const std::uint32_t num_of_segments = file.getNumOfSegments();
+        for (std::uint32_t i = 0; i < num_of_records; ++i)
         {
-            auto words_in_record = file.getActualRecordLength(i) / 2;
-            q_exchange.push([words_in_record, file_id, i, lambda_read_record, dev_addr]
-                            { lambda_read_record(dev_addr, file_id, i, words_in_record); });
+            // first segment is prepared before the task
+            if ((i != 0) && ((i % modbus::max_num_of_records) == 0))
+            {
+                pushTransferSetup(dev_addr, i / modbus::max_num_of_records, file_read_prepare);
+            }
+            auto words_in_record = (file.getActualRecordLength(i) + 1) / 2;
+            const std::uint16_t record_id = static_cast<std::uint16_t>(i % modbus::max_num_of_records);
+            q_exchange.push([words_in_record, file_id, record_id, lambda_read_record, dev_addr]
+                            { lambda_read_record(dev_addr, file_id, record_id, words_in_record); });
+        }
+        if (num_of_segments > 1)
+        {
+            pushRegistersWrite(dev_addr, modbus::holding_regs_offset + RegisterDefinitions::file_segment, {0, 0});
         }
+        task_info.reset(ClientTasks::file_read, static_cast<int>(q_exchange.size()), index, print_progress);
     };
     int index = getServerIndex(dev_addr);
     if (index ==server_not_found)
     {
         return make_error_code(ClientErrors::server_not_connected);
     }
-    if (servers[index].info.status == ServerStatus::unavailable)
+    if (getServerInfo(index).status == ServerStatus::unavailable)
     {
         return make_error_code(ClientErrors::server_not_connected);
     }
-    auto record_size = servers[index].info.record_size;
+    auto record_size = getServerInfo(index).record_size;
     if(record_size == 0)
     {
         return make_error_code(ClientErrors::max_record_length_not_configured);
     }
-    if (file.fileReadSetup(file_id, file_size, record_size) != true)
+    const bool file_ready = sink ? file.fileReadSetup(file_id, file_size, record_size, std::move(sink)) : file.fileReadSetup(file_id, file_size, record_size);
+    if (file_ready != true)
     {
         return make_error_code(ClientErrors::internal);
     }
-    auto error_code = taskWriteRegister(dev_addr, RegisterDefinitions::record_counter, file.getNumOfRecords());
-    if (error_code)
+    auto error_code = selectSegment(dev_addr, 0);
+    if (!error_code)
     {
-        return error_code;
+        error_code = writeTransferSetup(dev_addr, file_read_prepare, record_size);
     }
-    error_code = taskWriteRegister(dev_addr, RegisterDefinitions::file_control, file_read_prepare);
     if (error_code)
     {
         return error_code;
     }
-    // we are trying to reach this server through the gateway, perform gateway setup first
-    if (servers[index].info.gateway_addr != 0)
+    // gateway buffer is set up before every routed exchange, the gateway gets the same transfer setup
+    if (getServerInfo(index).gateway_addr != 0)
     {
-        auto gateway_index = getServerIndex(servers[index].info.gateway_addr);
-        if(servers[gateway_index].info.status == ServerStatus::unavailable)
-        {
-            return make_error_code(ClientErrors::gateway_not_connected);
-        }
-        std::uint16_t expected_length = getExpectedLength(ClientTasks::file_read, record_size);
-        error_code = taskWriteRegister(servers[index].info.gateway_addr, RegisterDefinitions::gateway_buffer_size, expected_length);
-        if (error_code)
-        {
-            return error_code;
-        }
-        error_code = taskWriteRegister(servers[index].info.gateway_addr, RegisterDefinitions::record_counter, file.getNumOfRecords());
-        if (error_code)
-        {
-            return error_code;
-        }
-        error_code = taskWriteRegister(servers[index].info.gateway_addr, RegisterDefinitions::file_control, file_read_prepare);
+        error_code = writeTransferSetup(getServerInfo(index).gateway_addr, file_read_prepare, record_size);
         if (error_code)
         {
             return error_code;
         }
     }
     task_info.reset();
-    q_task.push([dev_addr, index, lambda_read_file, file_id]() { lambda_read_file(dev_addr, index, file_id); });
-    while (!task_info.done.load(std::memory_order_relaxed))
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(default_task_wait_delay_ms));
-    }
-    return task_info.error_code;
+    return executeTask([dev_addr, index, lambda_read_file, file_id]() { lambda_read_file(dev_addr, index, file_id); });
 }
 
 std::error_code ModbusClient::taskWriteFile(const std::uint8_t dev_addr, const bool print_progress)
 {
-    auto lambda_write_record =
-        [this](const std::uint8_t dev_addr, const std::uint16_t file_id, const std::uint16_t record_id, const std::vector<std::uint8_t>& data)
-    {
-        modbus_message.msgWriteFileRecord(request_data, file_id, record_id, data, dev_addr);
-        // in case of success we expect message with the same length
-        std::uint16_t expected_length = getExpectedLength(ClientTasks::file_write, data.size());
-        TaskAttributes attr = TaskAttributes(modbus::FunctionCodes::write_file, expected_length);
-        createServerRequest(attr);
-    };
-
-    auto lambda_write_file = [this, lambda_write_record, print_progress](const std::uint8_t dev_addr, const int index, const std::uint16_t record_size)
-    {
-        const std::uint16_t num_of_records = file.getNumOfRecords();
-        const std::uint16_t file_id = file.getId();
-        task_info.reset(ClientTasks::file_write, num_of_records, index, print_progress);
-        for (std::uint16_t i = 0; i < num_of_records; ++i)
-        {
-            std::vector<std::uint8_t> data;
-            data.assign(&(file.getData()[i * record_size]), &(file.getData()[i * record_size]) + record_size);
-            q_exchange.push([lambda_write_record, dev_addr, file_id, i, data] { lambda_write_record(dev_addr, file_id, i, data); });
-        }
-    };
+    std::lock_guard<std::recursive_mutex> api_lock(api_mutex);
     int index = getServerIndex(dev_addr);
     if (index == server_not_found)
     {
         return make_error_code(ClientErrors::server_not_connected);
     }
-    if (servers[index].info.status == ServerStatus::unavailable)
+    if (getServerInfo(index).status == ServerStatus::unavailable)
     {
         return make_error_code(ClientErrors::server_not_connected);
     }
@@ -414,63 +515,405 @@ std::error_code ModbusClient::taskWriteFile(const std::uint8_t dev_addr, const b
     {
         return make_error_code(ClientErrors::file_buffer_is_empty);
     }
-    auto record_size = servers[index].info.record_size;
+    auto record_size = getServerInfo(index).record_size;
     if (record_size == 0)
     {
         return make_error_code(ClientErrors::max_record_length_not_configured);
     }
-    auto error_code = taskWriteRegister(dev_addr, RegisterDefinitions::record_counter, file.getNumOfRecords());
+    auto error_code = selectSegment(dev_addr, 0);
+    if (!error_code)
+    {
+        error_code = writeTransferSetup(dev_addr, file_write_prepare, record_size);
+    }
     if (error_code)
     {
         return error_code;
     }
-    error_code = taskWriteRegister(dev_addr, RegisterDefinitions::file_control, file_write_prepare);
+    // gateway buffer is set up before every routed exchange, the gateway gets the same transfer setup
+    if (getServerInfo(index).gateway_addr != 0)
+    {
+        error_code = writeTransferSetup(getServerInfo(index).gateway_addr, file_write_prepare, record_size);
+        if (error_code)
+        {
+            return error_code;
+        }
+    }
+    std::vector<std::uint32_t> records(file.getNumOfRecords());
+    std::iota(records.begin(), records.end(), 0);
+    return writeRecords(index, records, file_write_prepare, print_progress);
+}
+
+std::error_code ModbusClient::taskVerifyFile(const std::uint8_t dev_addr, const bool print_progress)
+{
+    std::lock_guard<std::recursive_mutex> api_lock(api_mutex);
+    if (getServerIndex(dev_addr) == server_not_found)
+    {
+        return make_error_code(ClientErrors::server_not_connected);
+    }
+    if (!file.isFileReady())
+    {
+        return make_error_code(ClientErrors::file_buffer_is_empty);
+    }
+    auto error_code = taskReadRegisters(dev_addr, modbus::holding_regs_offset + RegisterDefinitions::file_digest_high, 2, print_progress);
     if (error_code)
     {
         return error_code;
     }
-    // we are trying to reach this server through the gateway, perform gateway setup first
-    if (servers[index].info.gateway_addr != 0)
+    ServerRegisters registers;
+    getLastServerRegList(dev_addr, registers);
+    if (registers.values.size() != 2)
+    {
+        return make_error_code(ClientErrors::internal);
+    }
+    const std::uint32_t digest = (static_cast<std::uint32_t>(registers.values[0]) << 16) | registers.values[1];
+    return (digest == file.getDigest()) ? std::error_code() : make_error_code(ClientErrors::digest_mismatch);
+}
+
+std::error_code ModbusClient::taskBroadcastFile(const std::vector<std::uint8_t>& dev_addrs, const std::uint32_t baudrate, std::vector<std::error_code>& results,
+                                                const std::chrono::microseconds processing_time, const bool print_progress)
+{
+    std::lock_guard<std::recursive_mutex> api_lock(api_mutex);
+    auto lambda_broadcast_file = [this, print_progress](const std::uint32_t segment)
     {
-        auto gateway_index = getServerIndex(servers[index].info.gateway_addr);
-        if(servers[gateway_index].info.status == ServerStatus::unavailable)
+        const std::uint32_t first = segment * modbus::max_num_of_records;
+        const std::uint32_t last = first + file.getSegmentRecords(segment);
+        const std::uint16_t file_id = file.getId();
+        // transfer setup is the same as for unicast write, every server is prepared by one broadcast request
+        pushTransferSetup(modbus::broadcast_address, segment, file_write_prepare);
+        for (std::uint32_t i = first; i < last; ++i)
         {
-            return make_error_code(ClientErrors::gateway_not_connected);
+            q_exchange.push([this, file_id, i]
+            {
+                loadRecord(i);
+                modbus_message.msgWriteFileRecord(request_data, file_id, static_cast<std::uint16_t>(i % modbus::max_num_of_records), record_data,
+                                                  modbus::broadcast_address);
+                createServerRequest(TaskAttributes(modbus::FunctionCodes::undefined,
+                                                   getBroadcastPause(request_data.size(), broadcast_baudrate, broadcast_processing_time)));
+            });
         }
-        std::uint16_t expected_length = getExpectedLength(ClientTasks::file_write,record_size);
-        error_code = taskWriteRegister(servers[index].info.gateway_addr, RegisterDefinitions::gateway_buffer_size, expected_length);
+        task_info.reset(ClientTasks::file_broadcast, static_cast<int>(q_exchange.size()), server_not_found, print_progress);
+    };
+    results.assign(dev_addrs.size(), make_error_code(ClientErrors::server_not_connected));
+    if (!file.isFileReady())
+    {
+        return make_error_code(ClientErrors::file_buffer_is_empty);
+    }
+    const std::uint8_t record_size = file.getRecordSize();
+    if ((record_size == 0) || ((record_size % 2) != 0) || (baudrate == 0))
+    {
+        return make_error_code(ClientErrors::max_record_length_not_configured);
+    }
+    broadcast_baudrate = baudrate;
+    broadcast_processing_time = processing_time;
+    std::vector<bool> responding(dev_addrs.size(), true);
+    // server keeps one segment at a time, gaps are repaired before the next segment is selected
+    for (std::uint32_t segment = 0; segment < file.getNumOfSegments(); ++segment)
+    {
+        task_info.reset();
+        auto error_code = executeTask([lambda_broadcast_file, segment]() { lambda_broadcast_file(segment); });
         if (error_code)
         {
             return error_code;
         }
-        error_code = taskWriteRegister(servers[index].info.gateway_addr, RegisterDefinitions::record_counter, file.getNumOfRecords());
-        if (error_code)
+        // every server reports received records, only gaps are written with unicast requests
+        for (size_t i = 0; i < dev_addrs.size(); ++i)
         {
-            return error_code;
+            const int index = getServerIndex(dev_addrs[i]);
+            if ((index == server_not_found) || !responding[i])
+            {
+                continue;
+            }
+            results[i] = taskPing(dev_addrs[i]);
+            std::vector<std::uint32_t> missing;
+            for (int round = 0; !results[i] && (round <= max_broadcast_repair_rounds); ++round)
+            {
+                results[i] = readMissingRecords(index, segment, missing);
+                if (results[i] || missing.empty())
+                {
+                    break;
+                }
+                if (round == max_broadcast_repair_rounds)
+                {
+                    results[i] = make_error_code(ClientErrors::records_missing);
+                    break;
+                }
+                results[i] = writeRecords(index, missing);
+            }
+            // failed server misses the whole segment, it is not updated anymore
+            responding[i] = !results[i];
         }
-        error_code = taskWriteRegister(servers[index].info.gateway_addr, RegisterDefinitions::file_control, file_write_prepare);
-        if (error_code)
+    }
+    return std::error_code();
+}
+
+std::error_code ModbusClient::writeRecords(const int index, const std::vector<std::uint32_t>& records, const std::uint16_t file_control, const bool print_progress)
+{
+    auto lambda_write_record = [this](const std::uint8_t dev_addr, const std::uint16_t file_id, const std::uint32_t record)
+    {
+        loadRecord(record);
+        // record id is counted from the beginning of the selected segment
+        modbus_message.msgWriteFileRecord(request_data, file_id, static_cast<std::uint16_t>(record % modbus::max_num_of_records), record_data, dev_addr);
+        // in case of success we expect message with the same length
+        std::uint16_t expected_length = getExpectedLength(ClientTasks::file_write, record_data.size());
+        TaskAttributes attr = TaskAttributes(modbus::FunctionCodes::write_file, expected_length);
+        createServerRequest(attr);
+    };
+
+    auto lambda_write_file = [this, lambda_write_record, print_progress, file_control, records](const std::uint8_t dev_addr, const int index)
+    {
+        const std::uint16_t file_id = file.getId();
+        for (size_t i = 0; i < records.size(); ++i)
         {
-            return error_code;
+            const std::uint32_t record = records[i];
+            // first segment is prepared before the task
+            if ((file_control != 0) && (i != 0) && ((record % modbus::max_num_of_records) == 0))
+            {
+                pushTransferSetup(dev_addr, record / modbus::max_num_of_records, file_control);
+            }
+            // record is taken from the image only when it is sent
+            q_exchange.push([lambda_write_record, dev_addr, file_id, record] { lambda_write_record(dev_addr, file_id, record); });
         }
-    }
+        task_info.reset(ClientTasks::file_write, static_cast<int>(q_exchange.size()), index, print_progress);
+    };
+    const std::uint8_t dev_addr = getServerInfo(index).addr;
     task_info.reset();
-    q_task.push([dev_addr, lambda_write_file, index, record_size]() { lambda_write_file(dev_addr, index, record_size); });
-    while (!task_info.done.load(std::memory_order_relaxed))
+    return executeTask([dev_addr, lambda_write_file, index]() { lambda_write_file(dev_addr, index); });
+}
+
+std::error_code ModbusClient::readMissingRecords(const int index, const std::uint32_t segment, std::vector<std::uint32_t>& missing)
+{
+    auto lambda_read_record = [this](const std::uint8_t dev_addr, const std::uint16_t record_id, const std::uint16_t length)
+    {
+        modbus_message.msgReadFileRecord(request_data, FileDefinitions::record_map, record_id, length, dev_addr);
+        size_t expected_length = getExpectedLength(ClientTasks::record_map_read, length * 2);
+        TaskAttributes attr = TaskAttributes(modbus::FunctionCodes::read_file, expected_length);
+        createServerRequest(attr);
+    };
+
+    auto lambda_read_map = [this, lambda_read_record](const std::uint8_t dev_addr, const int index, const size_t map_size)
+    {
+        // map is read with the record size of the actual transfer, server calculates offset with it
+        const std::uint8_t record_size = file.getRecordSize();
+        const int num_of_reads = static_cast<int>((map_size + record_size - 1) / record_size);
+        task_info.reset(ClientTasks::record_map_read, num_of_reads, index);
+        for (int i = 0; i < num_of_reads; ++i)
+        {
+            const std::uint16_t words = static_cast<std::uint16_t>(std::min<size_t>(record_size, map_size - (i * record_size)) / 2);
+            q_exchange.push([lambda_read_record, dev_addr, i, words] { lambda_read_record(dev_addr, static_cast<std::uint16_t>(i), words); });
+        }
+    };
+    missing.clear();
+    const std::uint16_t num_of_records = file.getSegmentRecords(segment);
+    // one bit for every record, server reads whole half words only
+    const size_t map_size = ((num_of_records + 15) / 16) * 2;
+    const std::uint8_t dev_addr = getServerInfo(index).addr;
+    record_map.clear();
+    task_info.reset();
+    auto error_code = executeTask([dev_addr, lambda_read_map, index, map_size]() { lambda_read_map(dev_addr, index, map_size); });
+    if (error_code)
+    {
+        return error_code;
+    }
+    if (record_map.size() != map_size)
+    {
+        return make_error_code(ClientErrors::internal);
+    }
+    const std::uint32_t first = segment * modbus::max_num_of_records;
+    for (std::uint16_t i = 0; i < num_of_records; ++i)
+    {
+        if ((record_map[i / 8] & (1U << (i % 8))) == 0)
+        {
+            missing.push_back(first + i);
+        }
+    }
+    return std::error_code();
+}
+
+std::error_code ModbusClient::selectSegment(const std::uint8_t dev_addr, const std::uint32_t segment)
+{
+    const std::uint32_t num_of_segments = file.getNumOfSegments();
+    const std::vector<std::uint16_t> values{static_cast<std::uint16_t>(segment), static_cast<std::uint16_t>(num_of_segments)};
+    // segment left by an aborted transfer is reset before small files too
+    auto error_code = taskWriteRegisters(dev_addr, modbus::holding_regs_offset + RegisterDefinitions::file_segment, values);
+    if ((num_of_segments <= 1) && (error_code == make_error_code(ClientErrors::server_exception)))
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(default_task_wait_delay_ms));
+        // server without segment registers is still able to receive small files
+        return std::error_code();
+    }
+    return error_code;
+}
+
+std::error_code ModbusClient::writeTransferSetup(const std::uint8_t dev_addr, const std::uint16_t file_control, const std::uint8_t record_size)
+{
+    // only registers owned by the transfer are written, update and erase requests between them are left as they are
+    auto error_code = taskWriteRegisters(dev_addr, modbus::holding_regs_offset + RegisterDefinitions::record_size, {record_size, file.getSegmentRecords(0)});
+    if (!error_code)
+    {
+        error_code = taskWriteRegister(dev_addr, modbus::holding_regs_offset + RegisterDefinitions::file_control, file_control);
+    }
+    return error_code;
+}
+
+void ModbusClient::pushTransferSetup(const std::uint8_t dev_addr, const std::uint32_t segment, const std::uint16_t file_control)
+{
+    // written for small files too, nobody responds to broadcast and unicast setup inside the task is made for segmented files only
+    const std::uint32_t num_of_segments = file.getNumOfSegments();
+    pushRegistersWrite(dev_addr, modbus::holding_regs_offset + RegisterDefinitions::file_segment,
+                       {static_cast<std::uint16_t>(segment), static_cast<std::uint16_t>(num_of_segments)});
+    pushRegistersWrite(dev_addr, modbus::holding_regs_offset + RegisterDefinitions::record_size, {file.getRecordSize(), file.getSegmentRecords(segment)});
+    pushRegistersWrite(dev_addr, modbus::holding_regs_offset + RegisterDefinitions::file_control, {file_control});
+}
+
+void ModbusClient::pushRegistersWrite(const std::uint8_t dev_addr, const std::uint16_t reg_addr, const std::vector<std::uint16_t>& values)
+{
+    q_exchange.push([this, dev_addr, reg_addr, values]
+    {
+        modbus_message.msgWriteRegisters(request_data, reg_addr, values, dev_addr);
+        if (dev_addr == modbus::broadcast_address)
+        {
+            createServerRequest(TaskAttributes(modbus::FunctionCodes::undefined,
+                                               getBroadcastPause(request_data.size(), broadcast_baudrate, broadcast_processing_time)));
+            return;
+        }
+        createServerRequest(TaskAttributes(modbus::FunctionCodes::write_regs, getExpectedLength(ClientTasks::regs_write)));
+    });
+}
+
+void ModbusClient::loadRecord(const std::uint32_t index)
+{
+    if (!file.getRecord(index, record_data))
+    {
+        // task is stopped in client thread like on port error
+        throw std::system_error(make_error_code(ClientErrors::file_read_failed));
+    }
+}
+
+std::chrono::microseconds ModbusClient::getBroadcastPause(const size_t length, const std::uint32_t baudrate, const std::chrono::microseconds processing_time)
+{
+    // 11 bits for every character: start, 8 data bits, parity or second stop bit, stop
+    const std::uint64_t bits_per_char = 11;
+    const std::uint64_t frame_us = (length * bits_per_char * 1000000) / baudrate;
+    // 3.5 characters of silence, fixed value for baudrate above 19200
+    const std::uint64_t silence_us = (baudrate > 19200) ? 1750 : (35 * bits_per_char * 1000000) / (10 * baudrate);
+    return std::chrono::microseconds(frame_us + silence_us) + processing_time;
+}
+
+bool ModbusClient::prepareGateway(const std::uint8_t dev_addr, const size_t expected_length)
+{
+    int index = getServerIndex(dev_addr);
+    if ((dev_addr == modbus::broadcast_address) || (index == server_not_found) || (expected_length == 0))
+    {
+        return true;
+    }
+    const std::uint8_t gateway_addr = getServerInfo(index).gateway_addr;
+    if (gateway_addr == 0)
+    {
+        return true;
+    }
+    auto gateway_index = getServerIndex(gateway_addr);
+    if (gateway_index == server_not_found)
+    {
+        return false;
+    }
+    const ServerInfo gateway = getServerInfo(gateway_index);
+    if (gateway.status == ServerStatus::unavailable)
+    {
+        return false;
+    }
+    // gateway keeps the value until it is restarted, so most of exchanges need no extra one
+    if (gateway.gateway_buffer_size == expected_length)
+    {
+        return true;
+    }
+    std::vector<std::uint8_t> request;
+    std::vector<std::uint8_t> response;
+    modbus_message.msgWriteRegister(request, modbus::holding_regs_offset + RegisterDefinitions::gateway_buffer_size, expected_length, gateway_addr);
+    const bool success = directExchange(request, getExpectedLength(ClientTasks::reg_write), response);
+    std::lock_guard<std::mutex> lk(servers_mutex);
+    servers[gateway_index].info.gateway_buffer_size = success ? static_cast<std::uint16_t>(expected_length) : 0;
+    return success;
+}
+
+void ModbusClient::resetGatewayState(const int index)
+{
+    std::lock_guard<std::mutex> lk(servers_mutex);
+    if ((index < 0) || (static_cast<size_t>(index) >= servers.size()))
+    {
+        return;
+    }
+    servers[index].info.gateway_buffer_size = 0;
+    auto gateway_index = findServerIndex(servers[index].info.gateway_addr);
+    if ((servers[index].info.gateway_addr != 0) && (gateway_index != server_not_found))
+    {
+        servers[gateway_index].info.gateway_buffer_size = 0;
+    }
+}
+
+std::error_code ModbusClient::executeTask(std::function<void()>&& function)
+{
+    {
+        std::lock_guard<std::mutex> lk(wait_mutex);
+        q_task.push(std::move(function));
+    }
+    wakeUpClient();
+    std::unique_lock<std::mutex> lk(wait_mutex);
+    // client thread only counts exchanges, terminal output is made here at a limited rate
+    while (!task_completed.wait_for(lk, std::chrono::milliseconds(progress_print_period_ms), [this] { return task_info.done.load(std::memory_order_acquire); }))
+    {
+        if (task_info.is_printable.load(std::memory_order_relaxed))
+        {
+            lk.unlock();
+            printProgressBar(getActualTaskProgress());
+            lk.lock();
+        }
+    }
+    lk.unlock();
+    if (task_info.is_printable.load(std::memory_order_relaxed))
+    {
+        printProgressBar(getActualTaskProgress());
     }
     return task_info.error_code;
 }
 
+void ModbusClient::wakeUpClient()
+{
+    {
+        // client thread checks this flag under the lock before sleeping, notification can not be lost
+        std::lock_guard<std::mutex> lk(wait_mutex);
+        wake_up_requested = true;
+    }
+    client_wake_up.notify_one();
+}
+
+void ModbusClient::completeTask()
+{
+    {
+        std::lock_guard<std::mutex> lk(wait_mutex);
+        task_info.done.store(true, std::memory_order_release);
+    }
+    task_completed.notify_all();
+}
+
 void ModbusClient::clientThread()
 {
+    std::function<void()> next_task;
+    auto pop_task = [this](std::function<void()>& next)
+    {
+        std::lock_guard<std::mutex> lk(wait_mutex);
+        if (q_task.empty())
+        {
+            return false;
+        }
+        next = std::move(q_task.front());
+        q_task.pop();
+        return true;
+    };
     while (!thread_stop.load(std::memory_order_relaxed))
     {
-        while (!q_task.empty())
+        while (pop_task(next_task))
         {
             bool error_in_task = false;
-            q_task.front()();
+            next_task();
             while (!q_exchange.empty())
             {
                 try
@@ -497,15 +940,168 @@ void ModbusClient::clientThread()
                     q_exchange.pop();
                 }
             }
-            q_task.pop();
+            // task state is not touched by client thread after this point
+            next_task = nullptr;
+            completeTask();
+        }
+        // periodic polling keeps the bus busy while no task is queued
+        if (polling.load(std::memory_order_relaxed) && pollTask())
+        {
+            continue;
+        }
+        auto wake_up = PollClock::now() + std::chrono::milliseconds(default_task_wait_delay_ms);
+        if (polling.load(std::memory_order_relaxed))
+        {
+            wake_up = std::min(wake_up, poll_scheduler.getNextRelease());
+        }
+        std::unique_lock<std::mutex> lk(wait_mutex);
+        client_wake_up.wait_until(lk, wake_up, [this] { return wake_up_requested || thread_stop.load(std::memory_order_relaxed); });
+        wake_up_requested = false;
+    }
+}
+
+bool ModbusClient::pollTask()
+{
+    auto frame = poll_scheduler.next();
+    if (!frame)
+    {
+        return false;
+    }
+    bool success = false;
+    int index = getServerIndex(frame->dev_addr);
+    if ((index != server_not_found) && (getServerInfo(index).status == ServerStatus::available))
+    {
+        const size_t expected_length = getExpectedLength(ClientTasks::regs_read, frame->range.quantity * 2);
+        std::vector<std::uint8_t> request;
+        std::vector<std::uint8_t> response;
+        std::vector<std::uint8_t> message;
+        success = prepareGateway(frame->dev_addr, expected_length);
+        if (success)
+        {
+            modbus_message.msgReadRegisters(request, frame->range.start, frame->range.quantity, frame->dev_addr);
+            success = directExchange(request, expected_length, response) && modbus_message.extractData(response, message) &&
+                      (message[modbus::read_regs_response_data_length_idx] == (frame->range.quantity * 2));
+        }
+        if (success)
+        {
+            std::vector<std::uint16_t> values;
+            for (size_t i = modbus::read_regs_response_data_start_idx; (i + 1) < message.size(); i += 2)
+            {
+                values.push_back((static_cast<std::uint16_t>(message[i]) << 8) | message[i + 1]);
+            }
+            updateCache(getServer(index), frame->range.start, values);
+        }
+        else
+        {
+            resetGatewayState(index);
+        }
+    }
+    poll_scheduler.complete(*frame, success);
+    return true;
+}
+
+bool ModbusClient::directExchange(const std::vector<std::uint8_t>& request, const size_t expected_length, std::vector<std::uint8_t>& response)
+{
+    response.clear();
+    const auto begin = MetricsClock::now();
+    try
+    {
+        serial_port.writeBinary(request);
+        serial_port.readBinary(response, expected_length);
+    }
+    catch (const std::system_error& e)
+    {
+        return false;
+    }
+    recordExchange(request, response, expected_length, begin);
+    return (response.size() == expected_length) && modbus_message.isChecksumValid(response);
+}
+
+void ModbusClient::recordExchange(const std::vector<std::uint8_t>& request, const std::vector<std::uint8_t>& response, const size_t expected_length,
+                                  const MetricsClock::time_point begin)
+{
+    const auto end = MetricsClock::now();
+    capture.record(CaptureDirection::request, request.data(), request.size(), begin);
+    capture.record(CaptureDirection::response, response.data(), response.size(), end);
+    if (request.size() < (modbus::address_size + modbus::function_size))
+    {
+        return;
+    }
+    ExchangeResult result = ExchangeResult::success;
+    if (expected_length == 0)
+    {
+        result = ExchangeResult::broadcast;
+    }
+    else if (response.empty())
+    {
+        result = ExchangeResult::timeout;
+    }
+    else if (!modbus_message.isChecksumValid(response))
+    {
+        result = ExchangeResult::crc_error;
+    }
+    else if (response.size() != expected_length)
+    {
+        result = ExchangeResult::exception;
+    }
+    metrics.recordExchange(request[0], request[1], request.size(), response.size(), result, std::chrono::duration_cast<std::chrono::microseconds>(end - begin));
+}
+
+void ModbusClient::updateCache(ServerData& server, const std::uint16_t start, const std::vector<std::uint16_t>& values)
+{
+    {
+        std::lock_guard<std::mutex> lk(cache_mutex);
+        server.cache.update(start, values);
+    }
+    subscriptions.process(server.info.addr, start, values);
+}
+
+void ModbusClient::invalidateWrittenRange(const std::vector<std::uint8_t>& request)
+{
+    std::vector<std::uint8_t> message;
+    if (!modbus_message.extractData(request, message))
+    {
+        return;
+    }
+    // offset of start address and quantity of written registers in the request
+    size_t offset = 0;
+    switch (static_cast<modbus::FunctionCodes>(message[0]))
+    {
+        case modbus::FunctionCodes::write_reg:
+        case modbus::FunctionCodes::write_regs:
+            offset = 1;
+            break;
+
+        case modbus::FunctionCodes::read_write_regs:
+            offset = 5;
+            break;
+
+        default:
+            return;
+    }
+    if (message.size() < (offset + 4))
+    {
+        return;
+    }
+    RegisterRange range((static_cast<std::uint16_t>(message[offset]) << 8) | message[offset + 1], 1);
+    if (message[0] != static_cast<std::uint8_t>(modbus::FunctionCodes::write_reg))
+    {
+        range.quantity = (static_cast<std::uint16_t>(message[offset + 2]) << 8) | message[offset + 3];
+    }
+    std::lock_guard<std::mutex> servers_lock(servers_mutex);
+    std::lock_guard<std::mutex> cache_lock(cache_mutex);
+    for (auto& server : servers)
+    {
+        if ((request[0] == modbus::broadcast_address) || (server.info.addr == request[0]))
+        {
+            server.cache.invalidate(range);
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(default_task_wait_delay_ms));
     }
 }
 
 void ModbusClient::exchangeCallback()
 {
-    auto readRegs = [](ServerData& server, const std::vector<uint8_t>& message)
+    auto readRegs = [this](ServerData& server, const std::vector<uint8_t>& message)
     {
         server.registers.values.clear();
         const int id_length = modbus::read_regs_response_data_length_idx;
@@ -523,22 +1119,51 @@ void ModbusClient::exchangeCallback()
             server.registers.values.push_back(reg);
             index += 2;
         }
+        updateCache(server, server.registers.reg_start_address, server.registers.values);
         auto amount_of_regs = server.registers.values.size();
-        if(server.registers.reg_start_address <= (modbus::holding_regs_offset + RegisterDefinitions::record_size) &&
-           (server.registers.reg_start_address + amount_of_regs) >= (modbus::holding_regs_offset + RegisterDefinitions::record_size)
+        const std::uint16_t record_size_address = modbus::holding_regs_offset + RegisterDefinitions::record_size;
+        if(server.registers.reg_start_address <= record_size_address &&
+           (server.registers.reg_start_address + amount_of_regs) > record_size_address
           )
         {
-            server.info.record_size = server.registers.values[RegisterDefinitions::record_size];
+            std::lock_guard<std::mutex> lk(servers_mutex);
+            server.info.record_size = static_cast<std::uint8_t>(server.registers.values[record_size_address - server.registers.reg_start_address]);
         }
     };
 
+    // written values are kept in cache, request is taken from request_data
+    auto writeRegs = [this](ServerData& server, const size_t write_offset)
+    {
+        std::vector<std::uint8_t> request;
+        if (!modbus_message.extractData(request_data, request) || (request.size() <= write_offset + 4))
+        {
+            return;
+        }
+        const std::uint16_t start = (static_cast<std::uint16_t>(request[write_offset]) << 8) | request[write_offset + 1];
+        const std::uint16_t quantity = (static_cast<std::uint16_t>(request[write_offset + 2]) << 8) | request[write_offset + 3];
+        std::vector<std::uint16_t> values;
+        for (size_t i = write_offset + 5; (i + 1 < request.size()) && (values.size() < quantity); i += 2)
+        {
+            values.push_back((static_cast<std::uint16_t>(request[i]) << 8) | request[i + 1]);
+        }
+        updateCache(server, start, values);
+    };
+
     ++task_info.counter;
+    // written values are unknown until the response confirms them, e.g. after timeout or exception
+    invalidateWrittenRange(request_data);
+    if (task_info.task == ClientTasks::file_broadcast)
+    {
+        // nobody responds to broadcast request
+        return;
+    }
     if (modbus_message.isChecksumValid(response_data))
     {
         std::vector<std::uint8_t> message;
 
         if ((response_data.size() != task_info.attributes.length) || !modbus_message.extractData(response_data, message))
         {
+            resetGatewayState(task_info.index);
             task_info.error_code = make_error_code(ClientErrors::server_exception);
         }
         else
@@ -546,43 +1171,73 @@ void ModbusClient::exchangeCallback()
             switch (task_info.task)
             {
                 case ClientTasks::ping: // mark server as available if we have response on this command
-                    servers[task_info.index].info.status = ServerStatus::available;
+                    // exception from the gateway means that server behind it did not respond
+                    if ((message[1] == static_cast<std::uint8_t>(modbus::Exceptions::exception_10)) ||
+                        (message[1] == static_cast<std::uint8_t>(modbus::Exceptions::exception_11)))
+                    {
+                        setServerStatus(task_info.index, ServerStatus::unavailable);
+                        task_info.error_code = make_error_code(ClientErrors::timeout);
+                        break;
+                    }
+                    setServerStatus(task_info.index, ServerStatus::available);
+                    // server may be restarted since last exchange
+                    resetGatewayState(task_info.index);
                     break;
 
                 case ClientTasks::regs_read:
-                    readRegs(servers[task_info.index], message);
+                    readRegs(getServer(task_info.index), message);
+                    break;
+
+                case ClientTasks::reg_write: // response repeats register address and value
+                    updateCache(getServer(task_info.index), (static_cast<std::uint16_t>(message[1]) << 8) | message[2],
+                                {static_cast<std::uint16_t>((static_cast<std::uint16_t>(message[3]) << 8) | message[4])});
+                    break;
+
+                case ClientTasks::regs_write:
+                    writeRegs(getServer(task_info.index), 1);
+                    break;
+
+                case ClientTasks::regs_read_write:
+                    writeRegs(getServer(task_info.index), 5);
+                    readRegs(getServer(task_info.index), message);
                     break;
 
                 case ClientTasks::file_read:
-                    fileReadCallback(message);
+                case ClientTasks::file_write:
+                    // segment setup is written in the same task
+                    if (task_info.attributes.code == modbus::FunctionCodes::read_file)
+                    {
+                        fileReadCallback(message);
+                    }
+                    else if (task_info.attributes.code == modbus::FunctionCodes::write_regs)
+                    {
+                        writeRegs(getServer(task_info.index), 1);
+                    }
+                    break;
+
+                case ClientTasks::record_map_read:
+                    record_map.insert(record_map.end(), message.begin() + modbus::read_file_response_data_start_idx,
+                                      message.begin() + modbus::read_file_response_data_start_idx + message[modbus::read_file_response_data_length_idx]);
                     break;
 
                 default:
                     // nothing to do for now
                     break;
             }
-            if(task_info.is_printable)
-            {
-                printProgressBar(getActualTaskProgress());
-            }
-        }
-        if (task_info.counter == task_info.num_of_exchanges)
-        {
-            task_info.done.store(true, std::memory_order_relaxed);
         }
     }
     else
     {
+        resetGatewayState(task_info.index);
         if (response_data.size() == 0)
         {
-            servers[task_info.index].info.status = ServerStatus::unavailable;
+            setServerStatus(task_info.index, ServerStatus::unavailable);
             task_info.error_code = make_error_code(ClientErrors::timeout);
         }
         else
         {
             task_info.error_code = make_error_code(ClientErrors::bad_crc);
         }
-        task_info.done.store(true, std::memory_order_relaxed);
     }
 }
 
@@ -591,6 +1246,7 @@ size_t ModbusClient::getExpectedLength(const ClientTasks task, const size_t extr
     switch (task)
     {
         case sm::ClientTasks::undefined:
+        case sm::ClientTasks::file_broadcast:
             return 0;
         case sm::ClientTasks::ping:
             return modbus_message.getRequiredLength() + modbus::exception_pdu_size;
@@ -598,13 +1254,18 @@ size_t ModbusClient::getExpectedLength(const ClientTasks task, const size_t extr
         case sm::ClientTasks::reg_write:
             return modbus_message.getRequiredLength() + modbus::response_write_reg_pdu_size;
 
+        case sm::ClientTasks::regs_write:
+            return modbus_message.getRequiredLength() + modbus::response_write_regs_pdu_size;
+
         case sm::ClientTasks::regs_read:
+        case sm::ClientTasks::regs_read_write:
             return modbus_message.getRequiredLength() + modbus::response_read_reg_pdu_part + extra;
 
         case sm::ClientTasks::file_write:
             return modbus_message.getRequiredLength() + modbus::response_write_file_pdu_part + extra;
 
         case sm::ClientTasks::file_read:
+        case sm::ClientTasks::record_map_read:
             return modbus_message.getRequiredLength() + modbus::response_read_file_pdu_part + extra;
     };
     return 0;
@@ -620,6 +1281,11 @@ void ModbusClient::fileReadCallback(std::vector<std::uint8_t>& message)
 
 void ModbusClient::createServerRequest(const TaskAttributes& attr)
 {
+    // gateway is set up in the same task, so no other exchange can change it before the routed request
+    if (!request_data.empty() && !prepareGateway(request_data[0], attr.length))
+    {
+        throw std::system_error(make_error_code(ClientErrors::gateway_not_connected));
+    }
     task_info.attributes = attr;
     task = std::async(&ModbusClient::callServerExchange, this);
 }
@@ -627,6 +1293,7 @@ void ModbusClient::createServerRequest(const TaskAttributes& attr)
 void ModbusClient::callServerExchange()
 {
     response_data.clear();
+    const auto begin = MetricsClock::now();
     try
     {
         serial_port.writeBinary(request_data);
@@ -636,6 +1303,13 @@ void ModbusClient::callServerExchange()
         task_info.error_code = e.code();
         return;
     }
+    if (task_info.attributes.length == 0)
+    {
+        // broadcast request, servers are executing it and nobody responds
+        std::this_thread::sleep_for(task_info.attributes.pause);
+        recordExchange(request_data, response_data, 0, begin);
+        return;
+    }
     try
     {
         serial_port.readBinary(response_data, task_info.attributes.length);
@@ -645,6 +1319,7 @@ void ModbusClient::callServerExchange()
         task_info.error_code = e.code();
         return;
     }
+    recordExchange(request_data, response_data, task_info.attributes.length, begin);
 }
 
 } // namespace sm
@@ -45,6 +45,15 @@ class sm_category_impl : public std::error_category
 
             case sm::ClientErrors::max_record_length_not_configured:
                 return "record size for file read/write function is zero";
+
+            case sm::ClientErrors::records_missing:
+                return "the server did not receive all file records";
+
+            case sm::ClientErrors::digest_mismatch:
+                return "file digest on the server does not match the local file";
+
+            case sm::ClientErrors::file_read_failed:
+                return "failed to get file record from the image source";
             
             case sm::ClientErrors::internal:
                 return "internal logic error";
@@ -8,7 +8,9 @@
  */
 
 #include "../inc/sm_file.hpp"
+#include "../../common/sm_digest.hpp"
 #include "../../common/sm_modbus.hpp"
+#include <algorithm>
 #include <cstring>
 #include <fstream>
 #include <vector>
@@ -33,6 +35,8 @@ size_t File::getFileSize(const std::string path_to_file) const
 void File::fileDelete()
 {
     data.reset();
+    source.reset();
+    sink = nullptr;
     num_of_records = 0;
     record_size = 0;
     counter = 0;
@@ -42,7 +46,7 @@ void File::fileDelete()
 
 bool File::fileReadSetup(const std::uint16_t id, const size_t file_size, const std::uint8_t record_size)
 {
-    if (data)
+    if (data || source || sink)
     {
         fileDelete();
     }
@@ -73,80 +77,130 @@ bool File::fileReadSetup(const std::uint16_t id, const size_t file_size, const s
     }
 }
 
-bool File::fileWriteSetupFromDrive(const std::uint16_t id, const std::string path_to_file, const std::uint8_t record_size)
+bool File::fileReadSetup(const std::uint16_t id, const size_t file_size, const std::uint8_t record_size, RecordSink sink)
 {
-    if (data)
+    if (data || source || this->sink)
     {
         fileDelete();
     }
-    size_t length = getFileSize(path_to_file);
-    if (length > 0)
+    if ((record_size == 0) || !sink)
     {
-        std::ifstream tmp(path_to_file, std::ifstream::binary);
-        if (tmp)
-        {
-            this->id = id;
-            this->record_size = record_size;
-            num_of_records = calcNumOfRecords(length);
-            data = std::make_unique<std::uint8_t[]>(num_of_records * record_size);
-            std::memset(&data.get()[(num_of_records - 1) * record_size], 0xFF, record_size);
-            // load all file to RAM buffer at one time
-            tmp.read(reinterpret_cast<char*>(data.get()), length);
-            if (tmp)
-            {
-                file_size = length;
-            }
-            else
-            {
-                file_size = tmp.gcount();
-            }
-            tmp.close();
-        }
-        if (file_size == length)
-        {
-            ready = true;
-            return true;
-        }
-        else
-        {
-            return false;
-        }
+        return false;
     }
-    else
+    this->id = id;
+    this->record_size = record_size;
+    this->file_size = (file_size < record_size) ? record_size : file_size;
+    num_of_records = calcNumOfRecords(file_size);
+    this->sink = std::move(sink);
+    return true;
+}
+
+RecordSink File::makeDriveSink(const std::string path_to_file)
+{
+    auto stream = std::make_shared<std::ofstream>(path_to_file, std::ofstream::binary | std::ofstream::trunc);
+    if (!*stream)
     {
-        return false;
+        return RecordSink();
     }
+    // stream is closed when the sink is released after the last record
+    return [stream](const size_t offset, const std::uint8_t* data, const size_t length)
+    {
+        stream->seekp(offset);
+        stream->write(reinterpret_cast<const char*>(data), length);
+        // other processes may use received part of the file before the read is completed
+        stream->flush();
+        return static_cast<bool>(*stream);
+    };
+}
+
+bool File::fileWriteSetupFromDrive(const std::uint16_t id, const std::string path_to_file, const std::uint8_t record_size)
+{
+    // file is mapped, records are read from it only when they are sent
+    return fileWriteSetup(id, MappedImage::open(path_to_file), record_size);
 }
 
 bool File::fileWriteSetupFromMemory(const std::uint16_t id, const std::vector<std::uint8_t>& file_data, const std::uint8_t record_size)
 {
-    if (data)
+    // caller may release the vector right after the setup, one copy is kept
+    return fileWriteSetupShared(id, std::make_shared<const std::vector<std::uint8_t>>(file_data), record_size);
+}
+
+bool File::fileWriteSetupShared(const std::uint16_t id, std::shared_ptr<const std::vector<std::uint8_t>> image, const std::uint8_t record_size)
+{
+    if (!image || image->empty())
+    {
+        return false;
+    }
+    const std::uint8_t* memory = image->data();
+    const size_t length = image->size();
+    return fileWriteSetup(id, std::make_shared<MemoryImage>(memory, length, std::move(image)), record_size);
+}
+
+bool File::fileWriteSetup(const std::uint16_t id, std::shared_ptr<const ImageSource> source, const std::uint8_t record_size)
+{
+    if (data || this->source || sink)
     {
         fileDelete();
     }
-    if (file_data.size() > 0)
+    if (!source || (source->size() == 0))
     {
-        this->id = id;
-        this->record_size = record_size;
-        num_of_records = calcNumOfRecords(file_data.size());
-        data = std::make_unique<std::uint8_t[]>(num_of_records * record_size);
-        std::memset(&data.get()[(num_of_records - 1) * record_size], 0xFF, record_size);
-        std::copy(file_data.begin(), file_data.end(), data.get());
-        ready = true;
-        return true;
+        return false;
     }
-    else
+    this->id = id;
+    this->record_size = record_size;
+    num_of_records = calcNumOfRecords(source->size());
+    if (num_of_records == 0)
     {
         return false;
     }
+    this->source = std::move(source);
+    file_size = this->source->size();
+    ready = true;
+    return true;
+}
+
+bool File::getRecord(const std::uint32_t index, std::vector<std::uint8_t>& record) const
+{
+    const std::uint16_t length = getActualRecordLength(index);
+    const size_t offset = static_cast<size_t>(index) * record_size;
+    record.assign(record_size, 0xFF);
+    if (length == 0)
+    {
+        return false;
+    }
+    if (source)
+    {
+        return source->read(offset, record.data(), length);
+    }
+    if (data)
+    {
+        std::memcpy(record.data(), data.get() + offset, length);
+        return true;
+    }
+    return false;
 }
 
 bool File::getRecordFromMessage(const std::vector<std::uint8_t>& message)
 {
     const std::uint8_t data_idx = modbus::read_file_response_data_start_idx;
-    const std::uint8_t data_length = message[modbus::read_file_response_data_length_idx];
-    const int record_idx = counter * record_size;
+    // records are read in half words, the last byte of odd sized file is dropped
+    const std::uint16_t data_length = std::min<std::uint16_t>(message[modbus::read_file_response_data_length_idx], getActualRecordLength(counter));
+    const size_t record_idx = static_cast<size_t>(counter) * record_size;
 
+    if (sink)
+    {
+        if ((static_cast<size_t>(record_idx + data_length) > file_size) || !sink(record_idx, message.data() + data_idx, data_length))
+        {
+            return false;
+        }
+        ++counter;
+        if (counter == num_of_records)
+        {
+            ready = true;
+            sink = nullptr;
+        }
+        return true;
+    }
     if (static_cast<size_t>(record_idx + data_length) <= file_size)
     {
         std::copy(message.data() + data_idx, message.data() + data_idx + data_length, data.get() + record_idx);
@@ -163,29 +217,58 @@ bool File::getRecordFromMessage(const std::vector<std::uint8_t>& message)
     }
 }
 
-std::uint16_t File::calcNumOfRecords(const size_t file_size) const
+std::uint32_t File::getDigest() const
 {
-    std::uint16_t num_of_records = 0;
+    std::uint32_t crc = crc32_init;
+    std::vector<std::uint8_t> record;
+    for (std::uint32_t i = 0; i < num_of_records; ++i)
+    {
+        if (!getRecord(i, record))
+        {
+            break;
+        }
+        crc = crc32Update(crc, record.data(), record.size());
+    }
+    return crc32Final(crc);
+}
+
+std::uint32_t File::calcNumOfRecords(const size_t file_size) const
+{
+    std::uint32_t num_of_records = 0;
     if ((record_size > 0) && (file_size > 0))
     {
-        num_of_records = (file_size % record_size) ? ((file_size / record_size) + 1) : (file_size / record_size);
-        if (num_of_records > modbus::max_num_of_records)
+        const size_t records = (file_size % record_size) ? ((file_size / record_size) + 1) : (file_size / record_size);
+        if (records <= (static_cast<size_t>(max_num_of_segments) * modbus::max_num_of_records))
         {
-            num_of_records = 0;
+            num_of_records = static_cast<std::uint32_t>(records);
         }
     }
     return num_of_records;
 }
 
-std::uint16_t File::getActualRecordLength(const int index) const
+std::uint32_t File::getNumOfSegments() const
+{
+    return (num_of_records + modbus::max_num_of_records - 1) / modbus::max_num_of_records;
+}
+
+std::uint16_t File::getSegmentRecords(const std::uint32_t segment) const
+{
+    const std::uint32_t first = segment * modbus::max_num_of_records;
+    if (first >= num_of_records)
+    {
+        return 0;
+    }
+    return static_cast<std::uint16_t>(std::min<std::uint32_t>(num_of_records - first, modbus::max_num_of_records));
+}
+
+std::uint16_t File::getActualRecordLength(const std::uint32_t index) const
 {
     std::uint16_t length = 0;
-    if ((index < num_of_records) && (index >= 0))
+    if (index < num_of_records)
     {
-        // length = record_size;
-        if ((index + 1) == num_of_records)
+        if (((index + 1) == num_of_records) && ((file_size % record_size) != 0))
         {
-            length = (file_size == record_size) ? (file_size) : (file_size % record_size);
+            length = file_size % record_size;
         }
         else
         {
@@ -0,0 +1,324 @@
+/**
+ * @file sm_fleet.cpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#include "../inc/sm_fleet.hpp"
+#include <algorithm>
+#include <map>
+#include "../inc/sm_client.hpp"
+#include "../inc/sm_error.hpp"
+
+namespace sm
+{
+
+FleetUpdater::~FleetUpdater()
+{
+    wait();
+}
+
+FleetImage FleetUpdater::loadImage(const std::string& path)
+{
+    return MappedImage::open(path);
+}
+
+void FleetUpdater::addJob(const FleetJob& job)
+{
+    std::lock_guard<std::mutex> lk(results_mutex);
+    FleetJobResult result;
+    result.job = job;
+    results.push_back(result);
+    auto worker = std::find_if(workers.begin(), workers.end(), [&job](const std::unique_ptr<PortWorker>& item) { return item->port == job.port; });
+    if (worker == workers.end())
+    {
+        workers.push_back(std::make_unique<PortWorker>());
+        workers.back()->port = job.port;
+        worker = workers.end() - 1;
+    }
+    (*worker)->jobs.push_back(results.size() - 1);
+}
+
+void FleetUpdater::start()
+{
+    // clients are created before threads, so progress can be requested at any time
+    for (auto& worker : workers)
+    {
+        if (!worker->client)
+        {
+            worker->client = std::make_unique<ModbusClient>();
+        }
+    }
+    for (auto& worker : workers)
+    {
+        if (!worker->thread.joinable())
+        {
+            worker->thread = std::thread(&FleetUpdater::portTask, this, std::ref(*worker));
+        }
+    }
+}
+
+void FleetUpdater::wait()
+{
+    for (auto& worker : workers)
+    {
+        if (worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+    }
+}
+
+FleetProgress FleetUpdater::getProgress() const
+{
+    FleetProgress progress;
+    int sum = 0;
+    {
+        std::lock_guard<std::mutex> lk(results_mutex);
+        progress.total = results.size();
+        for (const auto& result : results)
+        {
+            switch (result.state)
+            {
+                case FleetJobState::running:
+                    ++progress.running;
+                    break;
+                case FleetJobState::done:
+                    ++progress.done;
+                    sum += task_complete_value;
+                    break;
+                case FleetJobState::failed:
+                    ++progress.failed;
+                    sum += task_complete_value;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    for (const auto& worker : workers)
+    {
+        if (worker->client && worker->transferring.load(std::memory_order_relaxed))
+        {
+            sum += worker->client->getActualTaskProgress();
+        }
+    }
+    progress.progress = (progress.total > 0) ? static_cast<int>(sum / static_cast<int>(progress.total)) : task_not_started_value;
+    return progress;
+}
+
+std::vector<FleetJobResult> FleetUpdater::getResults() const
+{
+    std::lock_guard<std::mutex> lk(results_mutex);
+    return results;
+}
+
+void FleetUpdater::portTask(PortWorker& worker)
+{
+    ModbusClient& client = *worker.client;
+    auto error_code = client.start(worker.port);
+    if (!error_code)
+    {
+        error_code = client.configure(config);
+    }
+    std::vector<bool> finished(results.size(), false);
+    if (!error_code && (broadcast_baudrate != 0))
+    {
+        // identical devices on the bus receive the image once
+        std::map<std::pair<const ImageSource*, std::uint16_t>, std::vector<size_t>> groups;
+        for (auto index : worker.jobs)
+        {
+            const FleetJob& job = results[index].job;
+            if ((job.gateway_addr == 0) && job.image)
+            {
+                groups[{job.image.get(), job.file_id}].push_back(index);
+            }
+        }
+        for (const auto& group : groups)
+        {
+            if (group.second.size() > 1)
+            {
+                updateGroup(worker, group.second);
+                for (auto index : group.second)
+                {
+                    finished[index] = true;
+                }
+            }
+        }
+    }
+    for (auto index : worker.jobs)
+    {
+        if (finished[index])
+        {
+            continue;
+        }
+        if (error_code)
+        {
+            // port is not available, every device on it fails with the same error
+            setState(index, FleetJobState::failed, error_code);
+            continue;
+        }
+        FleetJobResult result;
+        {
+            std::lock_guard<std::mutex> lk(results_mutex);
+            results[index].state = FleetJobState::running;
+            result = results[index];
+        }
+        const auto begin = std::chrono::steady_clock::now();
+        auto job_error = updateDevice(worker, result);
+        const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+        std::lock_guard<std::mutex> lk(results_mutex);
+        results[index].record_size = result.record_size;
+        results[index].state = job_error ? FleetJobState::failed : FleetJobState::done;
+        results[index].error_code = job_error;
+        results[index].duration = duration;
+    }
+    client.stop();
+}
+
+std::error_code FleetUpdater::updateDevice(PortWorker& worker, FleetJobResult& result)
+{
+    ModbusClient& client = *worker.client;
+    const FleetJob& job = result.job;
+    if (!job.image)
+    {
+        return make_error_code(ClientErrors::file_buffer_is_empty);
+    }
+    auto error_code = prepareDevice(client, job, result.record_size);
+    if (error_code)
+    {
+        return error_code;
+    }
+    client.setServerRecordMaxSize(job.dev_addr, result.record_size);
+    if (!client.file.fileWriteSetup(job.file_id, job.image, result.record_size))
+    {
+        return make_error_code(ClientErrors::file_buffer_is_empty);
+    }
+    worker.transferring.store(true, std::memory_order_relaxed);
+    error_code = client.taskWriteFile(job.dev_addr);
+    worker.transferring.store(false, std::memory_order_relaxed);
+    if (!error_code)
+    {
+        error_code = client.taskVerifyFile(job.dev_addr);
+    }
+    client.file.fileDelete();
+    return error_code;
+}
+
+void FleetUpdater::updateGroup(PortWorker& worker, const std::vector<size_t>& group)
+{
+    ModbusClient& client = *worker.client;
+    std::vector<FleetJob> jobs;
+    {
+        std::lock_guard<std::mutex> lk(results_mutex);
+        for (auto index : group)
+        {
+            results[index].state = FleetJobState::running;
+            jobs.push_back(results[index].job);
+        }
+    }
+    const auto begin = std::chrono::steady_clock::now();
+    std::vector<std::error_code> errors(group.size());
+    std::vector<std::uint8_t> addresses;
+    // broadcast record size must be accepted by every device, file records are read back in half words
+    std::uint8_t record_size = modbus::max_rw_file_record_size;
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        std::uint8_t device_record_size = 0;
+        errors[i] = prepareDevice(client, jobs[i], device_record_size);
+        if (!errors[i])
+        {
+            addresses.push_back(jobs[i].dev_addr);
+            record_size = std::min(record_size, device_record_size);
+        }
+    }
+    record_size &= static_cast<std::uint8_t>(~1U);
+    if (!addresses.empty())
+    {
+        std::vector<std::error_code> broadcast_errors;
+        std::error_code error_code;
+        if ((record_size == 0) || !client.file.fileWriteSetup(jobs[0].file_id, jobs[0].image, record_size))
+        {
+            error_code = make_error_code(ClientErrors::max_record_length_not_configured);
+        }
+        else
+        {
+            worker.transferring.store(true, std::memory_order_relaxed);
+            error_code = client.taskBroadcastFile(addresses, broadcast_baudrate, broadcast_errors);
+            worker.transferring.store(false, std::memory_order_relaxed);
+            for (size_t i = 0; !error_code && (i < addresses.size()); ++i)
+            {
+                if (!broadcast_errors[i])
+                {
+                    broadcast_errors[i] = client.taskVerifyFile(addresses[i]);
+                }
+            }
+            client.file.fileDelete();
+        }
+        for (size_t i = 0, j = 0; i < jobs.size(); ++i)
+        {
+            if (!errors[i])
+            {
+                errors[i] = error_code ? error_code : broadcast_errors[j];
+                ++j;
+            }
+        }
+    }
+    const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+    std::lock_guard<std::mutex> lk(results_mutex);
+    for (size_t i = 0; i < group.size(); ++i)
+    {
+        FleetJobResult& result = results[group[i]];
+        result.record_size = errors[i] ? 0 : record_size;
+        result.state = errors[i] ? FleetJobState::failed : FleetJobState::done;
+        result.error_code = errors[i];
+        result.duration = duration;
+    }
+}
+
+std::error_code FleetUpdater::prepareDevice(ModbusClient& client, const FleetJob& job, std::uint8_t& record_size)
+{
+    std::error_code error_code;
+    if (job.gateway_addr != 0)
+    {
+        client.addServer(job.gateway_addr);
+        error_code = client.taskPing(job.gateway_addr);
+        if (error_code)
+        {
+            return error_code;
+        }
+    }
+    client.addServer(job.dev_addr, job.gateway_addr);
+    error_code = client.taskPing(job.dev_addr);
+    if (error_code)
+    {
+        return error_code;
+    }
+    // record size is configured in the client when this register is read
+    error_code = client.taskReadRegisters(job.dev_addr, modbus::holding_regs_offset + RegisterDefinitions::record_size, 1);
+    if (error_code)
+    {
+        return error_code;
+    }
+    ServerRegisters registers;
+    client.getLastServerRegList(job.dev_addr, registers);
+    if (registers.values.empty() || (registers.values[0] == 0))
+    {
+        return make_error_code(ClientErrors::max_record_length_not_configured);
+    }
+    // server may report record size which does not fit in one request, smaller size is written with transfer setup
+    record_size = static_cast<std::uint8_t>(std::min<std::uint16_t>(registers.values[0], modbus::max_rw_file_record_size));
+    return error_code;
+}
+
+void FleetUpdater::setState(const size_t index, const FleetJobState state, const std::error_code& error_code)
+{
+    std::lock_guard<std::mutex> lk(results_mutex);
+    results[index].state = state;
+    results[index].error_code = error_code;
+}
+
+} // namespace sm
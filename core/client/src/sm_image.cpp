@@ -0,0 +1,96 @@
+/**
+ * @file sm_image.cpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#include "../inc/sm_image.hpp"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sm
+{
+
+bool MemoryImage::read(const size_t offset, std::uint8_t* data, const size_t length) const
+{
+    if ((this->data == nullptr) || (offset + length > this->length))
+    {
+        return false;
+    }
+    std::memcpy(data, this->data + offset, length);
+    return true;
+}
+
+std::shared_ptr<MappedImage> MappedImage::open(const std::string& path)
+{
+    std::shared_ptr<MappedImage> image(new MappedImage());
+#if defined(_WIN32)
+    // no mapping here, file is read at once
+    std::ifstream file(path, std::ifstream::binary);
+    if (!file)
+    {
+        return nullptr;
+    }
+    image->buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    image->data = image->buffer.data();
+    image->length = image->buffer.size();
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+    struct stat info;
+    if ((fstat(fd, &info) == 0) && (info.st_size > 0))
+    {
+        void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED)
+        {
+            // records are read in order, let the kernel read ahead
+            madvise(address, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+            image->data = static_cast<const std::uint8_t*>(address);
+            image->length = static_cast<size_t>(info.st_size);
+        }
+    }
+    // mapping stays valid after the descriptor is closed
+    ::close(fd);
+#endif
+    if (image->length == 0)
+    {
+        return nullptr;
+    }
+    return image;
+}
+
+MappedImage::~MappedImage()
+{
+#if !defined(_WIN32)
+    if (data != nullptr)
+    {
+        munmap(const_cast<std::uint8_t*>(data), length);
+    }
+#endif
+}
+
+bool MappedImage::read(const size_t offset, std::uint8_t* data, const size_t length) const
+{
+    if ((this->data == nullptr) || (offset + length > this->length))
+    {
+        return false;
+    }
+    std::memcpy(data, this->data + offset, length);
+    return true;
+}
+
+} // namespace sm
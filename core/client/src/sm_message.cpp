@@ -71,6 +71,35 @@ void ModbusMessage::msgReadRegisters(std::vector<std::uint8_t>& buffer, const st
     createMessage(buffer, static_cast<std::uint8_t>(FunctionCodes::read_regs), data, addr);
 }
 
+void ModbusMessage::msgWriteRegisters(std::vector<std::uint8_t>& buffer, const std::uint16_t reg, const std::vector<std::uint16_t>& values, const std::uint8_t addr)
+{
+    std::vector<std::uint8_t> data;
+    insertHalfWord(data, reg);
+    insertHalfWord(data, values.size());
+    data.push_back(static_cast<std::uint8_t>(values.size() * 2));
+    for (auto value : values)
+    {
+        insertHalfWord(data, value);
+    }
+    createMessage(buffer, static_cast<std::uint8_t>(FunctionCodes::write_regs), data, addr);
+}
+
+void ModbusMessage::msgReadWriteRegisters(std::vector<std::uint8_t>& buffer, const std::uint16_t read_reg, const std::uint16_t quantity,
+                                          const std::uint16_t write_reg, const std::vector<std::uint16_t>& values, const std::uint8_t addr)
+{
+    std::vector<std::uint8_t> data;
+    insertHalfWord(data, read_reg);
+    insertHalfWord(data, quantity);
+    insertHalfWord(data, write_reg);
+    insertHalfWord(data, values.size());
+    data.push_back(static_cast<std::uint8_t>(values.size() * 2));
+    for (auto value : values)
+    {
+        insertHalfWord(data, value);
+    }
+    createMessage(buffer, static_cast<std::uint8_t>(FunctionCodes::read_write_regs), data, addr);
+}
+
 bool ModbusMessage::isChecksumValid(const std::vector<std::uint8_t>& data) const
 {
     if (data.size() < min_pdu_with_data_size)
@@ -0,0 +1,328 @@
+/**
+ * @file sm_metrics.cpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#include "../inc/sm_metrics.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace sm
+{
+
+namespace
+{
+
+// Prometheus histogram bounds in microseconds, HDR buckets are folded into them on export
+constexpr std::uint64_t export_bounds_us[] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000};
+
+void writeHistogram(std::ostringstream& out, const std::string& labels, const HistogramSnapshot& histogram)
+{
+    for (auto bound : export_bounds_us)
+    {
+        out << "sm_exchange_latency_seconds_bucket{" << labels << ",le=\"" << (static_cast<double>(bound) / 1e6) << "\"} "
+            << histogram.getCountBelow(bound) << "\n";
+    }
+    out << "sm_exchange_latency_seconds_bucket{" << labels << ",le=\"+Inf\"} " << histogram.count << "\n";
+    out << "sm_exchange_latency_seconds_sum{" << labels << "} " << (static_cast<double>(histogram.sum_us) / 1e6) << "\n";
+    out << "sm_exchange_latency_seconds_count{" << labels << "} " << histogram.count << "\n";
+}
+
+} // namespace
+
+std::uint64_t HistogramSnapshot::getQuantile(const double quantile) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    const double clamped = std::min(std::max(quantile, 0.0), 1.0);
+    const std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(clamped * static_cast<double>(count) + 0.5));
+    std::uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+        {
+            return std::min(LatencyHistogram::getBucketUpperBound(i), max_us);
+        }
+    }
+    return max_us;
+}
+
+std::uint64_t HistogramSnapshot::getCountBelow(const std::uint64_t limit_us) const
+{
+    std::uint64_t result = 0;
+    for (size_t i = 0; (i < buckets.size()) && (LatencyHistogram::getBucketUpperBound(i) <= limit_us); ++i)
+    {
+        result += buckets[i];
+    }
+    return result;
+}
+
+void HistogramSnapshot::merge(const HistogramSnapshot& other)
+{
+    if (buckets.size() < other.buckets.size())
+    {
+        buckets.resize(other.buckets.size(), 0);
+    }
+    for (size_t i = 0; i < other.buckets.size(); ++i)
+    {
+        buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    sum_us += other.sum_us;
+    max_us = std::max(max_us, other.max_us);
+}
+
+void LatencyHistogram::record(const std::uint64_t value_us)
+{
+    const std::uint64_t value = std::min(value_us, max_value_us);
+    buckets[getBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum_us.fetch_add(value, std::memory_order_relaxed);
+    std::uint64_t max = max_us.load(std::memory_order_relaxed);
+    while ((value > max) && !max_us.compare_exchange_weak(max, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+HistogramSnapshot LatencyHistogram::snapshot() const
+{
+    // counters are read one by one, snapshot taken during recording may be off by the samples being recorded
+    HistogramSnapshot result;
+    result.buckets.resize(num_of_buckets);
+    for (size_t i = 0; i < num_of_buckets; ++i)
+    {
+        result.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+    result.count = count.load(std::memory_order_relaxed);
+    result.sum_us = sum_us.load(std::memory_order_relaxed);
+    result.max_us = max_us.load(std::memory_order_relaxed);
+    return result;
+}
+
+size_t LatencyHistogram::getBucketIndex(const std::uint64_t value_us)
+{
+    const std::uint64_t value = std::min(value_us, max_value_us);
+    const std::uint64_t linear = 2U << sub_bucket_bits;
+    if (value < linear)
+    {
+        return static_cast<size_t>(value);
+    }
+    unsigned magnitude = 0;
+    while ((value >> (magnitude + 1)) != 0)
+    {
+        ++magnitude;
+    }
+    const unsigned shift = magnitude - sub_bucket_bits;
+    const std::uint64_t sub_bucket = (value >> shift) - (1U << sub_bucket_bits);
+    return static_cast<size_t>(linear + ((magnitude - sub_bucket_bits - 1) << sub_bucket_bits) + sub_bucket);
+}
+
+std::uint64_t LatencyHistogram::getBucketUpperBound(const size_t index)
+{
+    const size_t linear = 2U << sub_bucket_bits;
+    if (index < linear)
+    {
+        return index;
+    }
+    const size_t position = index - linear;
+    const unsigned shift = static_cast<unsigned>(position >> sub_bucket_bits) + 1;
+    const std::uint64_t lower = ((1U << sub_bucket_bits) + (position & ((1U << sub_bucket_bits) - 1))) << shift;
+    return lower + (1ULL << shift) - 1;
+}
+
+void ExchangeStatistics::merge(const ExchangeStatistics& other)
+{
+    frames_sent += other.frames_sent;
+    frames_received += other.frames_received;
+    bytes_sent += other.bytes_sent;
+    bytes_received += other.bytes_received;
+    broadcasts += other.broadcasts;
+    timeouts += other.timeouts;
+    crc_errors += other.crc_errors;
+    exceptions += other.exceptions;
+    busy_time += other.busy_time;
+}
+
+std::string MetricsSnapshot::toPrometheus() const
+{
+    std::ostringstream out;
+    auto counter = [&out](const char* name, const char* help, std::uint64_t ExchangeStatistics::*field, const std::map<std::uint8_t, ServerMetrics>& servers)
+    {
+        out << "# HELP " << name << " " << help << "\n# TYPE " << name << " counter\n";
+        for (const auto& server : servers)
+        {
+            out << name << "{server=\"" << static_cast<unsigned>(server.first) << "\"} " << server.second.statistics.*field << "\n";
+        }
+    };
+    counter("sm_frames_sent_total", "Requests written to the bus.", &ExchangeStatistics::frames_sent, servers);
+    counter("sm_frames_received_total", "Responses with valid checksum.", &ExchangeStatistics::frames_received, servers);
+    counter("sm_bytes_sent_total", "Bytes written to the bus.", &ExchangeStatistics::bytes_sent, servers);
+    counter("sm_bytes_received_total", "Bytes read from the bus.", &ExchangeStatistics::bytes_received, servers);
+    counter("sm_broadcasts_total", "Requests without response.", &ExchangeStatistics::broadcasts, servers);
+    counter("sm_timeouts_total", "Requests without any response.", &ExchangeStatistics::timeouts, servers);
+    counter("sm_crc_errors_total", "Responses with invalid checksum.", &ExchangeStatistics::crc_errors, servers);
+    counter("sm_exceptions_total", "Responses with unexpected length or exception.", &ExchangeStatistics::exceptions, servers);
+    out << "# HELP sm_bus_busy_seconds_total Time spent in exchanges.\n# TYPE sm_bus_busy_seconds_total counter\n";
+    for (const auto& server : servers)
+    {
+        out << "sm_bus_busy_seconds_total{server=\"" << static_cast<unsigned>(server.first) << "\"} "
+            << (static_cast<double>(server.second.statistics.busy_time.count()) / 1e6) << "\n";
+    }
+    out << "# HELP sm_bus_utilization Part of client lifetime spent in exchanges.\n# TYPE sm_bus_utilization gauge\n";
+    out << "sm_bus_utilization " << bus_utilization << "\n";
+    out << "# HELP sm_exchange_latency_seconds Time from request write to the end of response.\n# TYPE sm_exchange_latency_seconds histogram\n";
+    for (const auto& server : servers)
+    {
+        for (const auto& function : server.second.latency)
+        {
+            std::ostringstream labels;
+            labels << "server=\"" << static_cast<unsigned>(server.first) << "\",function=\"" << static_cast<unsigned>(function.first) << "\"";
+            writeHistogram(out, labels.str(), function.second);
+        }
+    }
+    return out.str();
+}
+
+ClientMetrics::~ClientMetrics()
+{
+    for (auto& server : servers)
+    {
+        ServerSlot* slot = server.load(std::memory_order_acquire);
+        if (slot == nullptr)
+        {
+            continue;
+        }
+        for (auto& function : slot->functions)
+        {
+            delete function.load(std::memory_order_acquire);
+        }
+        delete slot;
+    }
+}
+
+template <typename T> T& ClientMetrics::getSlot(std::atomic<T*>& slot)
+{
+    T* value = slot.load(std::memory_order_acquire);
+    if (value == nullptr)
+    {
+        // exchanges are recorded by one thread at a time, but snapshot may be taken concurrently
+        T* created = new T();
+        if (slot.compare_exchange_strong(value, created, std::memory_order_acq_rel))
+        {
+            value = created;
+        }
+        else
+        {
+            delete created;
+        }
+    }
+    return *value;
+}
+
+void ClientMetrics::recordExchange(const std::uint8_t address, const std::uint8_t function, const size_t bytes_sent, const size_t bytes_received,
+                                   const ExchangeResult result, const std::chrono::microseconds duration)
+{
+    const std::uint64_t duration_us = static_cast<std::uint64_t>(std::max<std::chrono::microseconds::rep>(duration.count(), 0));
+    ServerSlot& server = getSlot(servers[(address <= modbus::max_rtu_address) ? address : modbus::broadcast_address]);
+    Counters& counters = server.counters;
+    counters.frames_sent.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes_sent.fetch_add(bytes_sent, std::memory_order_relaxed);
+    counters.bytes_received.fetch_add(bytes_received, std::memory_order_relaxed);
+    counters.busy_us.fetch_add(duration_us, std::memory_order_relaxed);
+    switch (result)
+    {
+        case ExchangeResult::broadcast:
+            counters.broadcasts.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case ExchangeResult::timeout:
+            counters.timeouts.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case ExchangeResult::crc_error:
+            counters.crc_errors.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case ExchangeResult::exception:
+            counters.frames_received.fetch_add(1, std::memory_order_relaxed);
+            counters.exceptions.fetch_add(1, std::memory_order_relaxed);
+            break;
+        default:
+            counters.frames_received.fetch_add(1, std::memory_order_relaxed);
+            break;
+    }
+    // latency of lost or broken responses is the timeout, it would only hide real server latency
+    if ((result == ExchangeResult::success) || (result == ExchangeResult::exception))
+    {
+        getSlot(server.functions[function]).record(duration_us);
+    }
+}
+
+MetricsSnapshot ClientMetrics::snapshot() const
+{
+    MetricsSnapshot result;
+    result.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(MetricsClock::now() - created);
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        const ServerSlot* slot = servers[i].load(std::memory_order_acquire);
+        if (slot == nullptr)
+        {
+            continue;
+        }
+        ServerMetrics& server = result.servers[static_cast<std::uint8_t>(i)];
+        const Counters& counters = slot->counters;
+        server.statistics.frames_sent = counters.frames_sent.load(std::memory_order_relaxed);
+        server.statistics.frames_received = counters.frames_received.load(std::memory_order_relaxed);
+        server.statistics.bytes_sent = counters.bytes_sent.load(std::memory_order_relaxed);
+        server.statistics.bytes_received = counters.bytes_received.load(std::memory_order_relaxed);
+        server.statistics.broadcasts = counters.broadcasts.load(std::memory_order_relaxed);
+        server.statistics.timeouts = counters.timeouts.load(std::memory_order_relaxed);
+        server.statistics.crc_errors = counters.crc_errors.load(std::memory_order_relaxed);
+        server.statistics.exceptions = counters.exceptions.load(std::memory_order_relaxed);
+        server.statistics.busy_time = std::chrono::microseconds(counters.busy_us.load(std::memory_order_relaxed));
+        for (size_t code = 0; code < slot->functions.size(); ++code)
+        {
+            const LatencyHistogram* histogram = slot->functions[code].load(std::memory_order_acquire);
+            if (histogram != nullptr)
+            {
+                server.latency[static_cast<std::uint8_t>(code)] = histogram->snapshot();
+                result.functions[static_cast<std::uint8_t>(code)].merge(server.latency[static_cast<std::uint8_t>(code)]);
+            }
+        }
+        result.total.merge(server.statistics);
+    }
+    if (result.elapsed.count() > 0)
+    {
+        const double seconds = static_cast<double>(result.elapsed.count()) / 1e6;
+        result.frames_per_second = static_cast<double>(result.total.frames_sent + result.total.frames_received) / seconds;
+        result.bytes_per_second = static_cast<double>(result.total.bytes_sent + result.total.bytes_received) / seconds;
+        result.bus_utilization = std::min(1.0, static_cast<double>(result.total.busy_time.count()) / static_cast<double>(result.elapsed.count()));
+    }
+    return result;
+}
+
+bool ClientMetrics::writePrometheus(const std::string& path) const
+{
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ofstream::trunc);
+        if (!file)
+        {
+            return false;
+        }
+        file << snapshot().toPrometheus();
+        if (!file)
+        {
+            return false;
+        }
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+} // namespace sm
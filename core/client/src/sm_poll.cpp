@@ -0,0 +1,171 @@
+/**
+ * @file sm_poll.cpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#include "../inc/sm_poll.hpp"
+#include <algorithm>
+#include "../../common/sm_modbus.hpp"
+
+namespace sm
+{
+
+int PollScheduler::addGroup(const PollGroup& group, const PollClock::time_point now)
+{
+    if ((group.range.quantity < modbus::min_amount_of_regs) || (group.range.quantity > modbus::max_amount_of_regs) || (group.period.count() <= 0))
+    {
+        return poll_group_not_found;
+    }
+    std::lock_guard<std::mutex> lk(m);
+    Job job;
+    job.group = group;
+    if ((job.group.deadline.count() <= 0) || (job.group.deadline > job.group.period))
+    {
+        job.group.deadline = job.group.period;
+    }
+    job.added = now;
+    job.release = now;
+    job.deadline = now + job.group.deadline;
+    jobs[next_id] = job;
+    return next_id++;
+}
+
+bool PollScheduler::removeGroup(const int id)
+{
+    std::lock_guard<std::mutex> lk(m);
+    return jobs.erase(id) != 0;
+}
+
+void PollScheduler::clear()
+{
+    std::lock_guard<std::mutex> lk(m);
+    jobs.clear();
+}
+
+bool PollScheduler::getStatistics(const int id, PollStatistics& statistics, const PollClock::time_point now) const
+{
+    std::lock_guard<std::mutex> lk(m);
+    auto it = jobs.find(id);
+    if (it == jobs.end())
+    {
+        return false;
+    }
+    statistics = it->second.statistics;
+    const double elapsed = std::chrono::duration<double>(now - it->second.added).count();
+    statistics.achieved_rate = (elapsed > 0.0) ? (static_cast<double>(statistics.completed) / elapsed) : 0.0;
+    return true;
+}
+
+std::optional<PollFrame> PollScheduler::next(const PollClock::time_point now)
+{
+    std::lock_guard<std::mutex> lk(m);
+    auto earliest = jobs.end();
+    for (auto it = jobs.begin(); it != jobs.end(); ++it)
+    {
+        if (isReleased(it->second, now) && ((earliest == jobs.end()) || (it->second.deadline < earliest->second.deadline)))
+        {
+            earliest = it;
+        }
+    }
+    if (earliest == jobs.end())
+    {
+        return std::nullopt;
+    }
+    PollFrame frame;
+    frame.dev_addr = earliest->second.group.dev_addr;
+    std::uint32_t start = earliest->second.group.range.start;
+    std::uint32_t end = start + earliest->second.group.range.quantity;
+    frame.groups.push_back(earliest->first);
+    // join other released groups of this server while the frame stays contiguous and fits into one request
+    bool joined = true;
+    while (joined)
+    {
+        joined = false;
+        for (auto it = jobs.begin(); it != jobs.end(); ++it)
+        {
+            const Job& job = it->second;
+            if ((job.group.dev_addr != frame.dev_addr) || !isReleased(job, now) ||
+                (std::find(frame.groups.begin(), frame.groups.end(), it->first) != frame.groups.end()))
+            {
+                continue;
+            }
+            const std::uint32_t job_start = job.group.range.start;
+            const std::uint32_t job_end = job_start + job.group.range.quantity;
+            const std::uint32_t new_start = std::min(start, job_start);
+            const std::uint32_t new_end = std::max(end, job_end);
+            if ((job_start <= end) && (job_end >= start) && ((new_end - new_start) <= modbus::max_amount_of_regs))
+            {
+                start = new_start;
+                end = new_end;
+                frame.groups.push_back(it->first);
+                joined = true;
+            }
+        }
+    }
+    for (auto id : frame.groups)
+    {
+        Job& job = jobs[id];
+        job.in_progress = true;
+        ++job.statistics.releases;
+    }
+    frame.range = RegisterRange(static_cast<std::uint16_t>(start), static_cast<std::uint16_t>(end - start));
+    return frame;
+}
+
+void PollScheduler::complete(const PollFrame& frame, const bool success, const PollClock::time_point now)
+{
+    std::lock_guard<std::mutex> lk(m);
+    for (auto id : frame.groups)
+    {
+        auto it = jobs.find(id);
+        if (it == jobs.end())
+        {
+            continue;
+        }
+        Job& job = it->second;
+        job.in_progress = false;
+        if (success)
+        {
+            ++job.statistics.completed;
+        }
+        else
+        {
+            ++job.statistics.errors;
+        }
+        if (now > job.deadline)
+        {
+            ++job.statistics.overruns;
+            job.statistics.max_lateness =
+                std::max(job.statistics.max_lateness, std::chrono::duration_cast<std::chrono::microseconds>(now - job.deadline));
+        }
+        job.release += job.group.period;
+        // releases missed completely are counted as overruns, schedule continues from the current period
+        if (job.release <= now)
+        {
+            const auto missed = (now - job.release) / job.group.period;
+            job.statistics.overruns += static_cast<std::uint64_t>(missed);
+            job.release += job.group.period * missed;
+        }
+        job.deadline = job.release + job.group.deadline;
+    }
+}
+
+PollClock::time_point PollScheduler::getNextRelease() const
+{
+    std::lock_guard<std::mutex> lk(m);
+    auto release = PollClock::time_point::max();
+    for (const auto& [id, job] : jobs)
+    {
+        if (!job.in_progress)
+        {
+            release = std::min(release, job.release);
+        }
+    }
+    return release;
+}
+
+} // namespace sm
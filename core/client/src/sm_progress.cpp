@@ -0,0 +1,78 @@
+/**
+ * @file sm_progress.cpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#include "../inc/sm_progress.hpp"
+#include <algorithm>
+
+namespace sm
+{
+
+ProgressMonitor::ProgressMonitor(Callback callback, const int rate_hz) :
+    callback(std::move(callback)), period(1000 / std::max(1, rate_hz)), observer(&ProgressMonitor::observerThread, this)
+{
+}
+
+ProgressMonitor::~ProgressMonitor()
+{
+    {
+        std::lock_guard<std::mutex> lk(stop_mutex);
+        stop = true;
+    }
+    stop_request.notify_one();
+    observer.join();
+}
+
+int ProgressMonitor::addSource(Sampler sampler)
+{
+    std::lock_guard<std::mutex> lk(sources_mutex);
+    sources[next_id] = std::move(sampler);
+    return next_id++;
+}
+
+bool ProgressMonitor::removeSource(const int id)
+{
+    std::lock_guard<std::mutex> lk(sources_mutex);
+    return sources.erase(id) != 0;
+}
+
+ProgressReport ProgressMonitor::getReport() const
+{
+    ProgressReport report;
+    std::lock_guard<std::mutex> lk(sources_mutex);
+    int sum = 0;
+    for (const auto& source : sources)
+    {
+        const int progress = std::min(std::max(source.second(), 0), 100);
+        report.sources[source.first] = progress;
+        sum += progress;
+    }
+    report.progress = sources.empty() ? 0 : (sum / static_cast<int>(sources.size()));
+    return report;
+}
+
+void ProgressMonitor::observerThread()
+{
+    ProgressReport last;
+    bool reported = false;
+    std::unique_lock<std::mutex> lk(stop_mutex);
+    while (!stop_request.wait_for(lk, period, [this] { return stop; }))
+    {
+        lk.unlock();
+        const ProgressReport report = getReport();
+        if (callback && (!reported || (report.progress != last.progress) || (report.sources != last.sources)))
+        {
+            callback(report);
+            last = report;
+            reported = true;
+        }
+        lk.lock();
+    }
+}
+
+} // namespace sm
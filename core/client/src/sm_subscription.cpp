@@ -0,0 +1,107 @@
+/**
+ * @file sm_subscription.cpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#include "../inc/sm_subscription.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace sm
+{
+
+int SubscriptionSet::subscribe(const Subscription& subscription)
+{
+    if ((subscription.range.quantity == 0) || !subscription.callback ||
+        (!subscription.deadbands.empty() && (subscription.deadbands.size() != subscription.range.quantity)))
+    {
+        return subscription_not_found;
+    }
+    std::lock_guard<std::mutex> lk(m);
+    Entry entry;
+    entry.subscription = subscription;
+    entry.reported.assign(subscription.range.quantity, 0);
+    entry.known.assign(subscription.range.quantity, false);
+    entries[next_id] = std::move(entry);
+    return next_id++;
+}
+
+bool SubscriptionSet::unsubscribe(const int id)
+{
+    std::lock_guard<std::mutex> lk(m);
+    return entries.erase(id) != 0;
+}
+
+void SubscriptionSet::clear()
+{
+    std::lock_guard<std::mutex> lk(m);
+    entries.clear();
+}
+
+void SubscriptionSet::process(const std::uint8_t dev_addr, const std::uint16_t start, const std::vector<std::uint16_t>& values)
+{
+    std::vector<std::pair<std::function<void(const std::uint8_t, const std::vector<RegisterChange>&)>, std::vector<RegisterChange>>> reports;
+    {
+        std::lock_guard<std::mutex> lk(m);
+        const std::uint32_t end = static_cast<std::uint32_t>(start) + values.size();
+        for (auto& [id, entry] : entries)
+        {
+            const Subscription& subscription = entry.subscription;
+            const std::uint32_t sub_start = subscription.range.start;
+            const std::uint32_t sub_end = sub_start + subscription.range.quantity;
+            if ((subscription.dev_addr != dev_addr) || (sub_end <= start) || (sub_start >= end))
+            {
+                continue;
+            }
+            // overlapping part, offsets in response and in subscription
+            const std::uint32_t first = std::max<std::uint32_t>(start, sub_start);
+            const std::uint32_t last = std::min(end, sub_end);
+            const size_t value_offset = first - start;
+            const size_t sub_offset = first - sub_start;
+            const size_t length = last - first;
+            const bool all_known = std::all_of(entry.known.begin() + sub_offset, entry.known.begin() + sub_offset + length, [](bool known) { return known; });
+            // unchanged response is the common case, one word-wise comparison skips it
+            if (all_known && std::equal(values.begin() + value_offset, values.begin() + value_offset + length, entry.reported.begin() + sub_offset))
+            {
+                continue;
+            }
+            std::vector<RegisterChange> changes;
+            for (size_t i = 0; i < length; ++i)
+            {
+                const std::uint16_t new_value = values[value_offset + i];
+                std::uint16_t& reported = entry.reported[sub_offset + i];
+                const std::uint16_t difference = (new_value > reported) ? (new_value - reported) : (reported - new_value);
+                const std::uint16_t deadband = subscription.deadbands.empty() ? 0 : subscription.deadbands[sub_offset + i];
+                if (!entry.known[sub_offset + i])
+                {
+                    changes.push_back(RegisterChange{static_cast<std::uint16_t>(first + i), new_value, new_value});
+                }
+                else if (difference > deadband)
+                {
+                    changes.push_back(RegisterChange{static_cast<std::uint16_t>(first + i), reported, new_value});
+                }
+                else
+                {
+                    continue;
+                }
+                reported = new_value;
+                entry.known[sub_offset + i] = true;
+            }
+            if (!changes.empty())
+            {
+                reports.emplace_back(subscription.callback, std::move(changes));
+            }
+        }
+    }
+    // callbacks are called without lock, so they may subscribe or unsubscribe
+    for (const auto& [callback, changes] : reports)
+    {
+        callback(dev_addr, changes);
+    }
+}
+
+} // namespace sm
@@ -25,23 +25,37 @@ public:
     static constexpr std::uint16_t record_counter = 4;
     static constexpr std::uint16_t status = 5;
     static constexpr std::uint16_t gateway_buffer_size = 6;
+    // read only, CRC32 of all records of the last completed file write, one pair for all files, so it describes
+    // the last written file only. Cleared by write setup, 0 until the write is completed, read setup keeps it
+    static constexpr std::uint16_t file_digest_high = 7;
+    static constexpr std::uint16_t file_digest_low = 8;
+    // files with more than modbus::max_num_of_records records are transferred in segments, segment is selected
+    // before transfer setup, both registers are cleared when the last record of the last segment is written
+    static constexpr std::uint16_t file_segment = 9;
+    static constexpr std::uint16_t file_segments = 10;
 
     static constexpr std::uint16_t getSize() { return size; }
 
 private:
-    static constexpr std::uint16_t size = 7;
+    static constexpr std::uint16_t size = 11;
 };
 
+// values of RegisterDefinitions::file_control written by the transfer setup
+constexpr std::uint16_t file_read_prepare = 1;
+constexpr std::uint16_t file_write_prepare = 2;
+
 class FileDefinitions
 {
 public:
     static constexpr std::uint16_t application = 1;
     static constexpr std::uint16_t metadata = 2;
+    // read only, bit n is set when record n was written since the last file_control write
+    static constexpr std::uint16_t record_map = 3;
 
     static constexpr std::uint16_t getSize() { return size; }
 
 private:
-    static constexpr std::uint16_t size = 2;
+    static constexpr std::uint16_t size = 3;
 };
 
 } // namespace sm
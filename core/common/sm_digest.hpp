@@ -0,0 +1,55 @@
+/**
+ * @file sm_digest.hpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#ifndef SM_DIGEST_HPP
+#define SM_DIGEST_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sm
+{
+
+// CRC32 with 0xEDB88320 poly (reflected IEEE 802.3, same as zlib), used as file digest
+constexpr std::uint32_t crc32_init = 0xFFFFFFFFu;
+
+struct Crc32Table
+{
+    std::uint32_t values[256] = {};
+    constexpr Crc32Table()
+    {
+        for (std::uint32_t i = 0; i < 256; ++i)
+        {
+            std::uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                crc = (crc & 1u) ? ((crc >> 1) ^ 0xEDB88320u) : (crc >> 1);
+            }
+            values[i] = crc;
+        }
+    }
+};
+
+constexpr Crc32Table crc32_table{};
+
+// crc starts from crc32_init, data may be passed in any number of parts
+inline std::uint32_t crc32Update(std::uint32_t crc, const std::uint8_t* data, const size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        crc = (crc >> 8) ^ crc32_table.values[(crc ^ data[i]) & 0xFFu];
+    }
+    return crc;
+}
+
+inline std::uint32_t crc32Final(const std::uint32_t crc) { return crc ^ 0xFFFFFFFFu; }
+
+} // namespace sm
+
+#endif // SM_DIGEST_HPP
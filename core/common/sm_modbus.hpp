@@ -24,13 +24,18 @@ constexpr std::uint16_t holding_regs_offset = 0x9C40;
 constexpr std::uint16_t files_offset = 0x0001;
 constexpr std::uint8_t function_error_mask = 0x80;
 constexpr std::uint8_t max_adu_size = 253;
+constexpr std::uint8_t broadcast_address = 0;
 constexpr std::uint8_t min_rtu_address = 1;
 constexpr std::uint8_t max_rtu_address = 247;
 constexpr std::uint8_t min_amount_of_regs = 1;
 constexpr std::uint8_t max_amount_of_regs = 125;
+constexpr std::uint8_t max_amount_of_write_regs = 123;
+constexpr std::uint8_t max_amount_of_read_write_regs = 121;
 constexpr std::uint8_t rw_file_reference = 6;
 constexpr std::uint8_t min_rw_file_byte_counter = 7;
 constexpr std::uint8_t max_rw_file_byte_counter = 245;
+// byte counter covers reference type, file, record, length and data
+constexpr std::uint8_t max_rw_file_record_size = max_rw_file_byte_counter - 7;
 constexpr std::uint8_t exception_pdu_size = function_size + 1;
 constexpr std::uint8_t min_pdu_with_data_size = function_size + 4;
 constexpr std::uint8_t read_regs_response_data_length_idx = 1;
@@ -44,6 +49,9 @@ constexpr std::uint8_t request_read_file_pdu_size = function_size + 8;
 constexpr std::uint8_t request_write_file_pdu_part = request_read_file_pdu_size;
 constexpr std::uint8_t response_read_file_pdu_part = function_size + 3;
 constexpr std::uint8_t response_write_file_pdu_part = request_write_file_pdu_part;
+constexpr std::uint8_t request_write_regs_pdu_part = function_size + 5;
+constexpr std::uint8_t response_write_regs_pdu_size = function_size + 4;
+constexpr std::uint8_t request_read_write_regs_pdu_part = function_size + 9;
 // table for CRC16 with 0xA001 poly
 constexpr std::uint16_t crc16_table[256] = {
     0X0000u, 0XC0C1u, 0XC181u, 0X0140u, 0XC301u, 0X03C0u, 0X0280u, 0XC241u, 0XC601u, 0X06C0u, 0X0780u, 0XC741u, 0X0500u, 0XC5C1u, 0XC481u, 0X0440u,
@@ -68,11 +76,13 @@ constexpr std::uint16_t crc16_table[256] = {
 // General Modbus function codes, for reference see https://modbus.org/
 enum class FunctionCodes
 {
-    read_regs = 0x3,   // read holding registers
-    write_reg = 0x6,   // write single register
-    read_file = 0x14,  // read file records
-    write_file = 0x15, // write file records
-    undefined = 0xFF,  // illegal function code
+    read_regs = 0x3,        // read holding registers
+    write_reg = 0x6,        // write single register
+    write_regs = 0x10,      // write multiple registers
+    read_file = 0x14,       // read file records
+    write_file = 0x15,      // write file records
+    read_write_regs = 0x17, // write and read multiple registers in one transaction
+    undefined = 0xFF,       // illegal function code
 };
 
 // General Modbus exception codes, for reference see https://modbus.org/
@@ -82,7 +92,9 @@ enum class Exceptions
     exception_1 = 1,
     exception_2 = 2,
     exception_3 = 3,
-    exception_4 = 4
+    exception_4 = 4,
+    exception_10 = 0x0A, // gateway path unavailable
+    exception_11 = 0x0B  // gateway target device failed to respond
 };
 
 } // namespace modbus
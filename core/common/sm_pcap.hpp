@@ -0,0 +1,59 @@
+/**
+ * @file sm_pcap.hpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#ifndef SM_PCAP_HPP
+#define SM_PCAP_HPP
+
+#include <cstdint>
+#include "sm_modbus.hpp"
+
+namespace sm
+{
+
+// pcap file with nanosecond timestamps, fields are written in host byte order, readers detect it by magic
+constexpr std::uint32_t pcap_magic_ns = 0xA1B23C4D;
+constexpr std::uint16_t pcap_version_major = 2;
+constexpr std::uint16_t pcap_version_minor = 4;
+// there is no link type for plain Modbus RTU frames, LINKTYPE_USER0 is used. Every packet starts with
+// one direction byte followed by the frame with address and CRC, in Wireshark: DLT_USER 147,
+// header size 1, payload protocol mbrtu
+constexpr std::uint32_t pcap_linktype_user0 = 147;
+constexpr std::uint32_t pcap_snap_length = modbus::max_adu_size + 1;
+
+enum class CaptureDirection : std::uint8_t
+{
+    request = 0,  // client to server
+    response = 1, // server to client
+};
+
+struct PcapFileHeader
+{
+    std::uint32_t magic = pcap_magic_ns;
+    std::uint16_t version_major = pcap_version_major;
+    std::uint16_t version_minor = pcap_version_minor;
+    std::int32_t this_zone = 0;
+    std::uint32_t sigfigs = 0;
+    std::uint32_t snap_length = pcap_snap_length;
+    std::uint32_t link_type = pcap_linktype_user0;
+};
+
+struct PcapRecordHeader
+{
+    std::uint32_t seconds = 0;
+    std::uint32_t nanoseconds = 0;
+    std::uint32_t captured_length = 0; // direction byte and stored part of the frame
+    std::uint32_t original_length = 0; // direction byte and whole frame
+};
+
+static_assert(sizeof(PcapFileHeader) == 24, "pcap file header must be packed");
+static_assert(sizeof(PcapRecordHeader) == 16, "pcap record header must be packed");
+
+} // namespace sm
+
+#endif // SM_PCAP_HPP
@@ -11,6 +11,7 @@
 #define SM_COM_HPP
 
 #include <atomic>
+#include "sm_event.hpp"
 
 namespace sm
 {
@@ -28,6 +29,7 @@ public:
         if(isConfigured())
         {
             ready.store(false, std::memory_order_relaxed);
+            busy.store(false, std::memory_order_relaxed);
             static_cast<Impl*>(this)->platformReadData(data,amount);
         }
     }
@@ -48,11 +50,22 @@ public:
     [[nodiscard]] bool isConfigured() const { return configured; }
     [[nodiscard]] bool isReady() const { return ready.load(std::memory_order_acquire); }
     [[nodiscard]] bool isBusy() const { return busy.load(std::memory_order_acquire); }
-    void setReady() { ready.store(true,std::memory_order_release); }
-    void setBusy() { busy.store(true,std::memory_order_release); }
+    void setReady()
+    {
+        busy.store(false,std::memory_order_relaxed);
+        ready.store(true,std::memory_order_release);
+        event_hook.notify();
+    }
+    void setBusy()
+    {
+        busy.store(true,std::memory_order_release);
+        event_hook.notify();
+    }
+    void setEventHook(const EventHook& hook) { event_hook = hook; }
 
 private:
     bool configured = false;
+    EventHook event_hook;
     std::atomic<bool> ready{false};
     std::atomic<bool> busy{false};
 };
@@ -0,0 +1,49 @@
+/**
+ * @file sm_event.hpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#ifndef SM_EVENT_HPP
+#define SM_EVENT_HPP
+
+#include <atomic>
+
+namespace sm
+{
+
+// hook called by Com and Timer implementations on every state change, safe to call from interrupt context
+struct EventHook
+{
+    void (*handler)(void*) = nullptr;
+    void* context = nullptr;
+    void notify() const
+    {
+        if(handler != nullptr) { handler(context); }
+    }
+};
+
+// wait policy for targets without OS, wfi should put core to sleep until next interrupt
+// and must return immediately if interrupt became pending after the flag check (disable irq, check, wfi, enable irq),
+// the flag is consumed only by the exchange, notify() from ISR between wfi() return and the next check is not lost
+template <void (*wfi)()>
+class InterruptWaitPolicy
+{
+public:
+    void wait()
+    {
+        // interrupts unrelated to Com and Timer wake up the core too, sleep again until the flag is set
+        while(!pending.exchange(false, std::memory_order_acquire)) { wfi(); }
+    }
+    void notify() { pending.store(true, std::memory_order_release); }
+
+private:
+    std::atomic<bool> pending{false};
+};
+
+} // namespace sm
+
+#endif // SM_EVENT_HPP
@@ -0,0 +1,313 @@
+/**
+ * @file sm_gateway.hpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#ifndef SM_GATEWAY_HPP
+#define SM_GATEWAY_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "sm_event.hpp"
+#include "sm_node.hpp"
+#include "sm_server.hpp"
+
+namespace sm
+{
+
+constexpr std::uint32_t gateway_response_timeout_ms = 200;
+constexpr std::uint8_t gateway_no_route = 0xFF;
+
+struct GatewayCounters
+{
+    std::uint32_t local = 0;     // requests served by the gateway itself
+    std::uint32_t forwarded = 0; // requests sent to downstream
+    std::uint32_t responses = 0; // downstream responses sent to upstream
+    std::uint32_t timeouts = 0;  // downstream did not respond, exception sent to upstream
+    std::uint32_t aborted = 0;   // new request for downstream arrived before response, previous exchange dropped
+    std::uint32_t queued_broadcasts = 0;  // broadcast kept for busy downstream and sent when it is idle
+    std::uint32_t dropped_broadcasts = 0; // busy downstream already had a queued broadcast
+};
+
+// frames for own address are served locally, frames for routed addresses are forwarded to downstream
+// and the response is sent back to upstream. Upstream receive is restarted in a free buffer as soon as
+// request is forwarded, so the next request is received while downstream exchange is running.
+// Buffer ownership moves between upstream and downstream, frames are never copied except broadcast for busy downstream.
+// WaitPolicy::wait() blocks until WaitPolicy::notify() is called by any Com or Timer event hook
+template<typename c, typename t, typename WaitPolicy, size_t num_of_downstreams = 1> class GatewayNode
+{
+public:
+    GatewayNode(std::uint8_t address, std::uint8_t record_size) : address(address), server(address,record_size) { routes.fill(gateway_no_route); }
+    // requests for addresses from first to last are forwarded to selected downstream
+    bool setRoute(const std::uint8_t first, const std::uint8_t last, const size_t downstream)
+    {
+        if((downstream >= num_of_downstreams) || (first < modbus::min_rtu_address) || (last > modbus::max_rtu_address) || (first > last)) { return false; }
+        for(size_t i = first; i <= last; ++i)
+        {
+            if(i != address) { routes[i] = static_cast<std::uint8_t>(downstream); }
+        }
+        return true;
+    }
+    void setResponseTimeout(const std::uint32_t timeout_ms) { response_timeout_ms = timeout_ms; }
+    void start()
+    {
+        const EventHook hook{&GatewayNode::onEvent, this};
+        upstream.setEventHook(hook);
+        upstream_timer.setEventHook(hook);
+        for(auto& link : links)
+        {
+            link.com.setEventHook(hook);
+            link.timer.setEventHook(hook);
+            link.com.init();
+        }
+        upstream.init();
+        startReceive(buffers[0].data());
+    }
+    void loop()
+    {
+        for(;;)
+        {
+            if(!upstream.isConfigured()) { break; }
+            if(upstream.isBusy() && !upstream_timer.isStarted())
+            {
+                upstream_timer.setTimeout(receive_timeout_ms);
+                upstream_timer.start();
+            }
+            handleTimeOut();
+            handleReady();
+            for(auto& link : links)
+            {
+                handleResponseTimeOut(link);
+                handleResponse(link);
+            }
+            wait_policy.wait();
+        }
+    }
+    c& getUpstream() { return upstream; }
+    c& getDownstream(const size_t index) { return links[index].com; }
+    ModbusServer& getServer() { return server; }
+    GatewayCounters getCounters() const { return counters; }
+
+private:
+    struct Link
+    {
+        c com;
+        t timer;
+        std::uint8_t* buffer = nullptr; // buffer with request and then response, nullptr if link is idle
+        std::uint8_t target = 0;        // request address and function, used for exception on timeout
+        std::uint8_t function = 0;
+        std::uint8_t received = 0;
+        // one broadcast received while the link was busy, sent as soon as the link is idle
+        std::array<std::uint8_t, modbus::max_adu_size> broadcast{};
+        std::uint8_t broadcast_length = 0;
+    };
+    const std::uint8_t address;
+    ModbusServer server;
+    // every link holds at most one buffer, one more buffer is always free for upstream receive
+    std::array<std::array<std::uint8_t, modbus::max_adu_size>, num_of_downstreams + 1> buffers;
+    std::array<std::uint8_t, modbus::max_rtu_address + 1> routes;
+    std::array<Link, num_of_downstreams> links;
+    std::uint8_t* rx = nullptr;
+    std::uint8_t received = 0;
+    std::uint32_t response_timeout_ms = gateway_response_timeout_ms;
+    GatewayCounters counters;
+    c upstream;
+    t upstream_timer;
+    WaitPolicy wait_policy;
+    static void onEvent(void* context) { static_cast<GatewayNode*>(context)->wait_policy.notify(); }
+    void handleTimeOut()
+    {
+        if(upstream_timer.isDone())
+        {
+            upstream_timer.stop();
+            if(upstream.isBusy() || (received != server.getReceiveBufferSize()))
+            {
+                // drop partially received frame
+                upstream.flush();
+                startReceive(rx);
+            }
+        }
+    }
+    void handleReady()
+    {
+        if(upstream.isReady())
+        {
+            upstream_timer.stop();
+            const std::uint16_t length = ModbusServer::getRequestLength(rx, received);
+            if(length > modbus::max_adu_size)
+            {
+                upstream.flush();
+                startReceive(rx);
+                return;
+            }
+            if((length == 0) || (length > received))
+            {
+                const std::uint8_t next = (length == 0) ? (received + 1) : static_cast<std::uint8_t>(length);
+                // truncated frame is dropped by handleTimeOut(), the next frame is not read as its tail
+                upstream_timer.setTimeout(receive_timeout_ms);
+                upstream_timer.start();
+                upstream.readData(rx + received, next - received);
+                received = next;
+                return;
+            }
+            dispatch(static_cast<std::uint8_t>(length));
+        }
+    }
+    void dispatch(const std::uint8_t length)
+    {
+        const std::uint8_t target = rx[0];
+        if(target == address)
+        {
+            ++counters.local;
+            server.serverTask(rx, length);
+            if(server.getTransmitBufferSize() != 0)
+            {
+                upstream.sendData(rx, server.getTransmitBufferSize());
+            }
+            startReceive(rx);
+            return;
+        }
+        if(target == modbus::broadcast_address)
+        {
+            // no response is expected, send to every idle downstream and keep the buffer
+            for(auto& link : links)
+            {
+                if(link.buffer == nullptr) { link.com.sendData(rx, length); }
+                else if(link.broadcast_length == 0)
+                {
+                    ++counters.queued_broadcasts;
+                    std::memcpy(link.broadcast.data(), rx, length);
+                    link.broadcast_length = length;
+                }
+                else { ++counters.dropped_broadcasts; }
+            }
+            startReceive(rx);
+            return;
+        }
+        const std::uint8_t route = (target <= modbus::max_rtu_address) ? routes[target] : gateway_no_route;
+        if(route == gateway_no_route)
+        {
+            // device on the upstream bus, not our business
+            startReceive(rx);
+            return;
+        }
+        Link& link = links[route];
+        if(!link.com.isConfigured())
+        {
+            upstream.sendData(rx, ModbusServer::buildException(rx, modbus::Exceptions::exception_10));
+            startReceive(rx);
+            return;
+        }
+        if(link.buffer != nullptr)
+        {
+            // client does not wait for the previous response anymore
+            ++counters.aborted;
+            release(link);
+        }
+        ++counters.forwarded;
+        link.buffer = rx;
+        link.target = rx[0];
+        link.function = rx[1];
+        link.com.sendData(link.buffer, length);
+        // address, function and exception code or byte counter are enough to define response length
+        link.received = modbus::address_size + modbus::function_size + 1;
+        link.com.readData(link.buffer, link.received);
+        link.timer.setTimeout(response_timeout_ms);
+        link.timer.start();
+        startReceive(getFreeBuffer());
+    }
+    void handleResponseTimeOut(Link& link)
+    {
+        if(link.timer.isDone())
+        {
+            link.timer.stop();
+            if(link.buffer != nullptr)
+            {
+                ++counters.timeouts;
+                link.buffer[0] = link.target;
+                link.buffer[1] = link.function;
+                upstream.sendData(link.buffer, ModbusServer::buildException(link.buffer, modbus::Exceptions::exception_11));
+                release(link);
+            }
+        }
+    }
+    void handleResponse(Link& link)
+    {
+        if((link.buffer == nullptr) || !link.com.isReady()) { return; }
+        if(link.buffer[0] != link.target)
+        {
+            // response from another device or garbage, wait for the right one until timeout
+            link.com.flush();
+            link.received = modbus::address_size + modbus::function_size + 1;
+            link.com.readData(link.buffer, link.received);
+            return;
+        }
+        const std::uint16_t default_length = server.getResources().getRegisterValue(RegisterDefinitions::gateway_buffer_size);
+        const std::uint16_t length = ModbusServer::getResponseLength(link.buffer, link.received, default_length);
+        if(length > modbus::max_adu_size)
+        {
+            link.com.flush();
+            link.received = modbus::address_size + modbus::function_size + 1;
+            link.com.readData(link.buffer, link.received);
+            return;
+        }
+        if((length == 0) || (length > link.received))
+        {
+            const std::uint8_t next = (length == 0) ? (link.received + 1) : static_cast<std::uint8_t>(length);
+            link.com.readData(link.buffer + link.received, next - link.received);
+            link.received = next;
+            return;
+        }
+        link.timer.stop();
+        ++counters.responses;
+        upstream.sendData(link.buffer, length);
+        setIdle(link);
+    }
+    void release(Link& link)
+    {
+        link.timer.stop();
+        link.com.flush();
+        setIdle(link);
+    }
+    void setIdle(Link& link)
+    {
+        link.buffer = nullptr;
+        if(link.broadcast_length != 0)
+        {
+            link.com.sendData(link.broadcast.data(), link.broadcast_length);
+            link.broadcast_length = 0;
+        }
+    }
+    std::uint8_t* getFreeBuffer()
+    {
+        for(auto& buffer : buffers)
+        {
+            bool used = (buffer.data() == rx);
+            for(const auto& link : links)
+            {
+                used = used || (link.buffer == buffer.data());
+            }
+            if(!used) { return buffer.data(); }
+        }
+        return rx;
+    }
+    void startReceive(std::uint8_t* buffer)
+    {
+        rx = buffer;
+        if(upstream.isConfigured())
+        {
+            received = server.getReceiveBufferSize();
+            upstream.readData(rx, received);
+        }
+    }
+};
+
+} // namespace sm
+
+#endif // SM_GATEWAY_HPP
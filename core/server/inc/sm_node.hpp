@@ -12,6 +12,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include "sm_event.hpp"
 #include "sm_server.hpp"
 
 namespace sm
@@ -19,17 +20,19 @@ namespace sm
 
 constexpr std::uint32_t receive_timeout_ms = 1000;
 
+// WaitPolicy::wait() blocks until WaitPolicy::notify() is called by Com or Timer event hook,
+// notification sent before wait() must not be lost
 template<typename c, typename t, typename WaitPolicy> class DataNode
 {
 public:
     DataNode(std::uint8_t address, std::uint8_t record_size) : server(address,record_size) {}
     void start()
     {
+        const EventHook hook{&DataNode::onEvent, this};
+        com.setEventHook(hook);
+        timer.setEventHook(hook);
         com.init();
-        if(com.isConfigured())
-        {
-            com.readData(buffer.data(),server.getReceiveBufferSize());
-        }
+        startReceive();
     }
     void loop()
     {
@@ -43,33 +46,73 @@ public:
             }
             handleTimeOut();
             handleReady();
-            WaitPolicy::wait();
+            wait_policy.wait();
         }
     }
     std::uint8_t* getBufferPtr() { return buffer.data(); };
+    ModbusServer& getServer() { return server; }
 
 private:
     ServerExceptions last_error = ServerExceptions::no_error;
     ModbusServer server;
     std::array<std::uint8_t, modbus::max_adu_size> buffer;
+    std::uint8_t received = 0; // bytes requested from com for the current frame
     c com;
     t timer;
+    WaitPolicy wait_policy;
+    static void onEvent(void* context) { static_cast<DataNode*>(context)->wait_policy.notify(); }
     void handleTimeOut()
     {
-        if(timer.isDone() && com.isBusy())
+        if(timer.isDone())
         {
-            com.flush();
             timer.stop();
-            com.readData(buffer.data(),server.getReceiveBufferSize());
+            if(com.isBusy() || isFrameStarted())
+            {
+                // drop partially received frame
+                com.flush();
+                startReceive();
+            }
         }
     }
     void handleReady()
     {
         if(com.isReady())
         {
-            last_error = server.serverTask(buffer.data(), server.getReceiveBufferSize());
-            com.sendData(buffer.data(),server.getTransmitBufferSize());
-            com.readData(buffer.data(),server.getReceiveBufferSize());
+            timer.stop();
+            // first part covers the shortest request, the rest of the frame is read when the header defines it
+            const std::uint16_t length = ModbusServer::getRequestLength(buffer.data(), received);
+            if(length > buffer.size())
+            {
+                com.flush();
+                startReceive();
+                return;
+            }
+            if((length == 0) || (length > received))
+            {
+                const std::uint8_t next = (length == 0) ? (received + 1) : static_cast<std::uint8_t>(length);
+                // rest of the frame may never come, e.g. client stopped in the middle of the frame
+                timer.setTimeout(receive_timeout_ms);
+                timer.start();
+                com.readData(buffer.data() + received, next - received);
+                received = next;
+                return;
+            }
+            last_error = server.serverTask(buffer.data(), static_cast<std::uint8_t>(length));
+            if(server.getTransmitBufferSize() != 0)
+            {
+                com.sendData(buffer.data(),server.getTransmitBufferSize());
+            }
+            startReceive();
+        }
+    }
+    // header is received, com is not busy until the first byte of the continuation read
+    bool isFrameStarted() const { return received != server.getReceiveBufferSize(); }
+    void startReceive()
+    {
+        if(com.isConfigured())
+        {
+            received = server.getReceiveBufferSize();
+            com.readData(buffer.data(),received);
         }
     }
 };
@@ -13,7 +13,10 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include "../../common/sm_common.hpp"
+#include "../../common/sm_digest.hpp"
+#include "../../common/sm_modbus.hpp"
 
 namespace sm
 {
@@ -38,6 +41,7 @@ struct FileControl
     size_t index = 0;                 // file index in files array in chip memory
     std::uint8_t* p_record = nullptr; // pointer to record
     std::uint8_t length = 0;          // actual record length in bytes
+    bool is_last = false;             // last record of the transfer configured with record_counter and file_segments
 };
 
 struct FileService
@@ -54,7 +58,8 @@ struct FileInfo
     FileInfo(Attributes attributes, FileData data) : attributes(attributes), data(data) {}
     Attributes attributes;
     FileData data;
-    void (*callback)(const FileInfo*) = nullptr; // callback on the end of write operation
+    void (*callback)(const FileInfo*, const FileControl*) = nullptr; // callback on the end of record write operation
+    void* context = nullptr;                                          // owner of the callback, not used by the server
 };
 
 struct RegisterInfo
@@ -66,23 +71,77 @@ struct RegisterInfo
     void (*callback)(const RegisterInfo*) = nullptr; // callback on the end of write operation
 };
 
+// big-endian shadow copy of the register values and readable bitmask, read request is a mask test and one copy
+template <size_t num_of_regs>
+class RegisterImage
+{
+public:
+    void update(const size_t index, const RegisterInfo& info)
+    {
+        image[index * 2] = static_cast<std::uint8_t>(info.value >> 8);
+        image[(index * 2) + 1] = static_cast<std::uint8_t>(info.value);
+        const std::uint64_t bit = std::uint64_t(1) << (index % 64);
+        readable[index / 64] = info.attributes.property_read ? (readable[index / 64] | bit) : (readable[index / 64] & ~bit);
+    }
+    bool isReadable(const size_t offset, const size_t quantity) const
+    {
+        size_t first = offset;
+        const size_t end = offset + quantity;
+        while (first < end)
+        {
+            const size_t last = (((first / 64) + 1) * 64 < end) ? ((first / 64) + 1) * 64 : end;
+            const size_t width = last - first;
+            const std::uint64_t mask = ((width == 64) ? ~std::uint64_t(0) : ((std::uint64_t(1) << width) - 1)) << (first % 64);
+            if ((readable[first / 64] & mask) != mask) { return false; }
+            first = last;
+        }
+        return true;
+    }
+    void copy(const size_t offset, const size_t quantity, std::uint8_t* data) const { std::memcpy(data, &image[offset * 2], quantity * 2); }
+    static constexpr size_t size() { return num_of_regs; }
+
+private:
+    std::array<std::uint8_t, num_of_regs * 2> image{};
+    std::array<std::uint64_t, (num_of_regs + 63) / 64> readable{};
+};
+
 class ServerResources
 {
 public:
-    ServerResources(std::uint8_t record_size) : record_size(record_size) {}
+    ServerResources(std::uint8_t record_size);
+    bool setRegister(const std::uint16_t index, const RegisterInfo& info);
+    bool setFile(const std::uint16_t file_id, const FileInfo& info);
     bool writeRegister(const std::uint16_t address, const std::uint16_t value);
+    // all values are stored before the first callback is called, nothing is stored if any register is rejected
+    bool writeRegisters(const std::uint16_t address, const std::uint16_t quantity, const std::uint8_t* data);
     bool readRegister(const std::uint16_t address, const std::uint16_t quantity, std::uint8_t* data, std::uint8_t& size);
     bool writeFile(const FileService& service, const std::uint8_t* data);
     bool readFile(const FileService& service, std::uint8_t* data, std::uint8_t& size);
     void setBufferSize(const std::uint8_t new_size){ buffer_size = new_size; }    
     std::uint8_t getBufferSize() const { return buffer_size; }
+    std::uint16_t getRegisterValue(const std::uint16_t index) const { return (index < registers.size()) ? registers[index].value : 0; }
     static std::uint16_t extractHalfWord(const std::uint8_t* data);
     static void insertHalfWord(std::uint8_t* data, const std::uint16_t half_word);
 private:
-    const std::uint8_t record_size;
+    const std::uint8_t record_size; // max record size, active size is configured in RegisterDefinitions::record_size
+    int getFileIndex(const std::uint16_t file_id) const;
+    bool isWriteAllowed(const std::uint16_t index, const std::uint16_t value) const;
+    std::uint8_t getActiveRecordSize() const { return static_cast<std::uint8_t>(registers[RegisterDefinitions::record_size].value); }
+    std::uint64_t getRecordOffset(const FileService& service) const;
     std::uint8_t buffer_size = 0;
     std::array<RegisterInfo, RegisterDefinitions::getSize()> registers;
+    RegisterImage<RegisterDefinitions::getSize()> image;
     std::array<FileInfo, FileDefinitions::getSize()> files;
+    // received records of the actual transfer, client reads it as FileDefinitions::record_map to find gaps
+    std::array<std::uint8_t, (modbus::max_num_of_records + 7) / 8> record_map{};
+    std::uint16_t received_records = 0;
+    // digest is updated with every record written in order, any other order is fixed by one pass over the file at the end
+    std::uint32_t digest = crc32_init;
+    std::uint32_t digest_offset = 0;
+    bool digest_in_order = true;
+    void onRegisterWritten(const std::uint16_t index);
+    void updateDigest(const FileInfo& file, const std::uint32_t offset, const std::uint32_t length, const bool is_last);
+    void setDigestRegisters(const std::uint32_t value);
 };
 
 } // namespace sm
@@ -34,8 +34,15 @@ public:
         setBufferSize(modbus::address_size + modbus::min_pdu_with_data_size + modbus::crc_size);
     }
     ServerExceptions serverTask(std::uint8_t* data, const std::uint8_t length);
+    // full request length in bytes defined by frame header, 0 if more bytes are required to decide
+    static std::uint16_t getRequestLength(const std::uint8_t* data, const std::uint8_t available);
+    // full response length in bytes defined by frame header, default_length is used for unknown functions
+    static std::uint16_t getResponseLength(const std::uint8_t* data, const std::uint8_t available, const std::uint16_t default_length);
+    // replace request in data with exception response, returns response length
+    static std::uint8_t buildException(std::uint8_t* data, const modbus::Exceptions exception);
     std::uint8_t getReceiveBufferSize() const { return server_resources.getBufferSize(); }
     std::uint8_t getTransmitBufferSize() const { return transmit_length; }
+    ServerResources& getResources() { return server_resources; }
 
 private:
     const std::uint8_t address;
@@ -43,8 +50,11 @@ private:
     ServerResources server_resources;
 
     void setBufferSize(const std::uint8_t new_size){ server_resources.setBufferSize(new_size); }
+    ServerExceptions processRequest(std::uint8_t* data, const std::uint8_t length);
     modbus::Exceptions writeRegister(std::uint8_t* data);
     modbus::Exceptions readRegister(std::uint8_t* data, std::uint8_t& length);
+    modbus::Exceptions writeRegisters(std::uint8_t* data, std::uint8_t& length);
+    modbus::Exceptions readWriteRegisters(std::uint8_t* data, std::uint8_t& length);
     modbus::Exceptions writeFile(std::uint8_t* data);
     modbus::Exceptions readFile(std::uint8_t* data, std::uint8_t& length);
     void generateException(std::uint8_t* data, const modbus::Exceptions exception);
@@ -12,6 +12,7 @@
 
 #include <cstdint>
 #include <atomic>
+#include "sm_event.hpp"
 
 namespace sm
 {
@@ -26,19 +27,25 @@ public:
         {
             stop();
         }
-        static_cast<Impl*>(this)->platformStart();
+        // platform may report expiration right after start, state must be ready before
         done.store(false,std::memory_order_release);
         started.store(true,std::memory_order_release);
+        static_cast<Impl*>(this)->platformStart();
     }
     void stop()
     {
         static_cast<Impl*>(this)->platformStop();
-        done.load(std::memory_order_acquire);
+        started.store(false, std::memory_order_release);
         done.store(false, std::memory_order_release);
     }
     bool isStarted() const { return started.load(std::memory_order_acquire); }
     bool isDone() const { return done.load(std::memory_order_acquire); }
-    void setDone() const { done.store(true,std::memory_order_release); }
+    void setDone()
+    {
+        done.store(true,std::memory_order_release);
+        event_hook.notify();
+    }
+    void setEventHook(const EventHook& hook) { event_hook = hook; }
     void setTimeout(const std::uint32_t timeout)
     {
         if(!started.load(std::memory_order_acquire)) { timeout_ms = timeout; }
@@ -49,6 +56,7 @@ private:
     std::atomic<bool> done{false};
     std::atomic<bool> started{false};
     std::uint32_t timeout_ms = 0;
+    EventHook event_hook;
 };
 
 } // namespace sm
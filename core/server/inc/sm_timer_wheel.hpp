@@ -0,0 +1,133 @@
+/**
+ * @file sm_timer_wheel.hpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#ifndef SM_TIMER_WHEEL_HPP
+#define SM_TIMER_WHEEL_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace sm
+{
+
+// intrusive timer entry, owned by the user, no allocations in the wheel
+struct TimerWheelEntry
+{
+    TimerWheelEntry* next = nullptr;
+    TimerWheelEntry* prev = nullptr;
+    std::uint64_t expiry = 0;            // absolute expiry tick
+    void (*callback)(void*) = nullptr;   // called from TimerWheel::advance()
+    void* context = nullptr;
+    bool isActive() const { return next != nullptr; }
+};
+
+// hierarchical timer wheel, start and stop are O(1), expired entries are cascaded to lower levels on wrap
+template <size_t levels = 4, size_t slot_bits = 6>
+class TimerWheel
+{
+public:
+    TimerWheel()
+    {
+        for (auto& head : heads)
+        {
+            head.next = &head;
+            head.prev = &head;
+        }
+    }
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    void start(TimerWheelEntry& entry, const std::uint64_t ticks)
+    {
+        stop(entry);
+        entry.expiry = now + ((ticks == 0) ? 1 : ticks);
+        insert(entry);
+        ++active;
+    }
+    void stop(TimerWheelEntry& entry)
+    {
+        if (entry.isActive())
+        {
+            unlink(entry);
+            --active;
+        }
+    }
+    void advance(const std::uint64_t ticks)
+    {
+        for (std::uint64_t i = 0; i < ticks; ++i)
+        {
+            ++now;
+            const size_t index = now & slot_mask;
+            // on wrap of the lower level move entries from the next level down
+            if (index == 0)
+            {
+                for (size_t level = 1; level < levels; ++level)
+                {
+                    const size_t level_index = (now >> (level * slot_bits)) & slot_mask;
+                    cascade(level, level_index);
+                    if (level_index != 0) { break; }
+                }
+            }
+            TimerWheelEntry& head = heads[index];
+            while (head.next != &head)
+            {
+                TimerWheelEntry* entry = head.next;
+                unlink(*entry);
+                --active;
+                if (entry->callback != nullptr) { entry->callback(entry->context); }
+            }
+        }
+    }
+    bool empty() const { return active == 0; }
+    std::uint64_t getNow() const { return now; }
+
+private:
+    static constexpr size_t slots = size_t(1) << slot_bits;
+    static constexpr size_t slot_mask = slots - 1;
+    std::array<TimerWheelEntry, levels * slots> heads;
+    std::uint64_t now = 0;
+    size_t active = 0;
+
+    void insert(TimerWheelEntry& entry)
+    {
+        const std::uint64_t delta = entry.expiry - now;
+        size_t level = 0;
+        while ((level < (levels - 1)) && (delta >= (std::uint64_t(1) << ((level + 1) * slot_bits)))) { ++level; }
+        std::uint64_t expiry = entry.expiry;
+        // out of range timeouts wait in the last slot of the highest level
+        if (delta >= (std::uint64_t(1) << (levels * slot_bits))) { expiry = now + (std::uint64_t(1) << (levels * slot_bits)) - 1; }
+        TimerWheelEntry& head = heads[(level * slots) + ((expiry >> (level * slot_bits)) & slot_mask)];
+        entry.prev = head.prev;
+        entry.next = &head;
+        head.prev->next = &entry;
+        head.prev = &entry;
+    }
+    static void unlink(TimerWheelEntry& entry)
+    {
+        entry.prev->next = entry.next;
+        entry.next->prev = entry.prev;
+        entry.next = nullptr;
+        entry.prev = nullptr;
+    }
+    void cascade(const size_t level, const size_t index)
+    {
+        TimerWheelEntry& head = heads[(level * slots) + index];
+        while (head.next != &head)
+        {
+            TimerWheelEntry* entry = head.next;
+            unlink(*entry);
+            insert(*entry);
+        }
+    }
+};
+
+} // namespace sm
+
+#endif // SM_TIMER_WHEEL_HPP
@@ -8,19 +8,61 @@
  */
 
 #include "../inc/sm_resources.hpp"
+#include <cstring>
 #include "../../common/sm_modbus.hpp"
 
 namespace sm
 {
 
+ServerResources::ServerResources(std::uint8_t record_size) : record_size(record_size)
+{
+    const Attributes read_write{true, true, false};
+    const Attributes read_only{true, false, false};
+    registers[RegisterDefinitions::file_control] = RegisterInfo(read_write, 0);
+    registers[RegisterDefinitions::prepare_to_update] = RegisterInfo(read_write, 0);
+    registers[RegisterDefinitions::app_erase] = RegisterInfo(read_write, 0);
+    // client may select smaller record size for the next transfer
+    registers[RegisterDefinitions::record_size] = RegisterInfo(read_write, record_size);
+    registers[RegisterDefinitions::record_counter] = RegisterInfo(read_write, 0);
+    registers[RegisterDefinitions::status] = RegisterInfo(read_only, 0);
+    registers[RegisterDefinitions::gateway_buffer_size] = RegisterInfo(read_write, 0);
+    registers[RegisterDefinitions::file_digest_high] = RegisterInfo(read_only, 0);
+    registers[RegisterDefinitions::file_digest_low] = RegisterInfo(read_only, 0);
+    registers[RegisterDefinitions::file_segment] = RegisterInfo(read_write, 0);
+    registers[RegisterDefinitions::file_segments] = RegisterInfo(read_write, 0);
+    for (size_t i = 0; i < registers.size(); ++i)
+    {
+        image.update(i, registers[i]);
+    }
+    files[FileDefinitions::record_map - modbus::files_offset] = FileInfo(read_only, FileData{record_map.data(), static_cast<std::uint32_t>(record_map.size())});
+}
+
+bool ServerResources::setRegister(const std::uint16_t index, const RegisterInfo& info)
+{
+    if (index >= registers.size()) { return false; }
+    registers[index] = info;
+    image.update(index, info);
+    return true;
+}
+
+bool ServerResources::setFile(const std::uint16_t file_id, const FileInfo& info)
+{
+    const int index = getFileIndex(file_id);
+    if (index == not_found) { return false; }
+    files[index] = info;
+    return true;
+}
+
 bool ServerResources::writeRegister(const std::uint16_t address, const std::uint16_t value)
 {
     if(address < modbus::holding_regs_offset) { return false; }
     const std::uint16_t offset_address = address - modbus::holding_regs_offset;
-    if (offset_address > registers.size()) { return false; }
-    if(registers[offset_address].attributes.property_write)
+    if (offset_address >= registers.size()) { return false; }
+    if(isWriteAllowed(offset_address, value))
     {
         registers[offset_address].value = value;
+        image.update(offset_address, registers[offset_address]);
+        onRegisterWritten(offset_address);
         if(registers[offset_address].callback != nullptr)
         {
             registers[offset_address].callback(&registers[offset_address]);
@@ -30,38 +72,184 @@ bool ServerResources::writeRegister(const std::uint16_t address, const std::uint
     else { return false; }
 }
 
-bool ServerResources::readRegister(const std::uint16_t address, const std::uint16_t quantity, std::uint8_t* data, std::uint8_t& size)
+bool ServerResources::writeRegisters(const std::uint16_t address, const std::uint16_t quantity, const std::uint8_t* data)
 {
     if(address < modbus::holding_regs_offset) { return false; }
     const std::uint16_t offset_address = address - modbus::holding_regs_offset;
-    if (offset_address > (registers.size() - quantity )) { return false; }
-    data[0] = static_cast<std::uint8_t>((quantity * 2));
-    int counter = 1;
-    for (int i = 0; i < quantity; ++i)
+    if ((offset_address + quantity) > registers.size()) { return false; }
+    for (std::uint16_t i = 0; i < quantity; ++i)
+    {
+        if (!isWriteAllowed(offset_address + i, extractHalfWord(data + (i * 2)))) { return false; }
+    }
+    for (std::uint16_t i = 0; i < quantity; ++i)
     {
-        if(registers[offset_address + i].attributes.property_read)
+        registers[offset_address + i].value = extractHalfWord(data + (i * 2));
+        image.update(offset_address + i, registers[offset_address + i]);
+        onRegisterWritten(offset_address + i);
+    }
+    // callbacks see the whole block, e.g. file_control handler already has record_counter
+    for (std::uint16_t i = 0; i < quantity; ++i)
+    {
+        if(registers[offset_address + i].callback != nullptr)
         {
-            insertHalfWord(&data[counter], registers[offset_address + i].value);
-            counter += 2;
+            registers[offset_address + i].callback(&registers[offset_address + i]);
         }
-        else { return false; }
     }
+    return true;
+}
+
+bool ServerResources::readRegister(const std::uint16_t address, const std::uint16_t quantity, std::uint8_t* data, std::uint8_t& size)
+{
+    if(address < modbus::holding_regs_offset) { return false; }
+    const std::uint16_t offset_address = address - modbus::holding_regs_offset;
+    if ((offset_address + quantity) > registers.size()) { return false; }
+    if (!image.isReadable(offset_address, quantity)) { return false; }
+    data[0] = static_cast<std::uint8_t>((quantity * 2));
+    image.copy(offset_address, quantity, &data[1]);
     size =  data[0] + 1;
     return true;
 }
 
 bool ServerResources::writeFile(const FileService& service, const std::uint8_t* data)
 {
-    (void)(service);
-    (void)(data);
+    const int index = getFileIndex(service.file_id);
+    if (index == not_found) { return false; }
+    FileInfo& file = files[index];
+    const std::uint32_t length = service.length * sizeof(std::uint16_t);
+    const std::uint64_t position = getRecordOffset(service);
+    if (!file.attributes.property_write || (file.data.p_data == nullptr)) { return false; }
+    if ((length > getActiveRecordSize()) || ((position + length) > file.data.size)) { return false; }
+    const std::uint32_t offset = static_cast<std::uint32_t>(position);
+    // record goes straight to the file memory, no intermediate buffers
+    std::memcpy(file.data.p_data + offset, data, length);
+    const std::uint16_t record_counter = registers[RegisterDefinitions::record_counter].value;
+    bool is_last = (service.record_id + 1) == record_counter;
+    if (service.record_id < modbus::max_num_of_records)
+    {
+        const std::uint8_t mask = static_cast<std::uint8_t>(1U << (service.record_id % 8));
+        if ((record_map[service.record_id / 8] & mask) == 0)
+        {
+            record_map[service.record_id / 8] |= mask;
+            ++received_records;
+        }
+        // records missed in broadcast transfer come later, file is complete when every record is received
+        is_last = received_records == record_counter;
+    }
+    // every segment is completed separately, file is completed with the last one
+    const std::uint16_t segment = registers[RegisterDefinitions::file_segment].value;
+    is_last = is_last && ((segment + 1U) >= registers[RegisterDefinitions::file_segments].value);
+    updateDigest(file, offset, length, is_last);
+    if (file.callback != nullptr)
+    {
+        FileControl control;
+        control.index = index;
+        control.p_record = file.data.p_data + offset;
+        control.length = static_cast<std::uint8_t>(length);
+        control.is_last = is_last;
+        file.callback(&file, &control);
+    }
+    if (is_last && (segment != 0))
+    {
+        // clients without segment support start from the file beginning
+        registers[RegisterDefinitions::file_segment].value = 0;
+        registers[RegisterDefinitions::file_segments].value = 0;
+        image.update(RegisterDefinitions::file_segment, registers[RegisterDefinitions::file_segment]);
+        image.update(RegisterDefinitions::file_segments, registers[RegisterDefinitions::file_segments]);
+    }
     return true;
 }
 
 bool ServerResources::readFile(const FileService& service, std::uint8_t* data, std::uint8_t& size)
 {
-    (void)(service);
-    (void)(data);
-    (void)(size);
+    const int index = getFileIndex(service.file_id);
+    if (index == not_found) { return false; }
+    const FileInfo& file = files[index];
+    const std::uint32_t length = service.length * sizeof(std::uint16_t);
+    const std::uint64_t position = getRecordOffset(service);
+    if (!file.attributes.property_read || (file.data.p_data == nullptr)) { return false; }
+    if ((length > getActiveRecordSize()) || ((position + length) > file.data.size)) { return false; }
+    const std::uint32_t offset = static_cast<std::uint32_t>(position);
+    // response length, record length, reference type, record data
+    data[0] = static_cast<std::uint8_t>(length + 2);
+    data[1] = static_cast<std::uint8_t>(length);
+    data[2] = modbus::rw_file_reference;
+    std::memcpy(&data[3], file.data.p_data + offset, length);
+    size = static_cast<std::uint8_t>(length + 3);
+    return true;
+}
+
+void ServerResources::onRegisterWritten(const std::uint16_t index)
+{
+    // every transfer starts with file control write, records of the previous one are forgotten
+    if (index == RegisterDefinitions::file_control)
+    {
+        record_map.fill(0);
+        received_records = 0;
+        // digest of the last written file stays readable while the file is read back
+        if (registers[RegisterDefinitions::file_control].value != file_write_prepare)
+        {
+            return;
+        }
+        // digest covers all segments of the file
+        if (registers[RegisterDefinitions::file_segment].value == 0)
+        {
+            digest = crc32_init;
+            digest_offset = 0;
+            digest_in_order = true;
+        }
+        setDigestRegisters(0);
+    }
+}
+
+void ServerResources::updateDigest(const FileInfo& file, const std::uint32_t offset, const std::uint32_t length, const bool is_last)
+{
+    if (digest_in_order && (offset == digest_offset))
+    {
+        digest = crc32Update(digest, file.data.p_data + offset, length);
+        digest_offset += length;
+    }
+    else
+    {
+        digest_in_order = false;
+    }
+    if (!is_last) { return; }
+    if (!digest_in_order)
+    {
+        // records came out of order or repeated, all of them are in the file memory now
+        const std::uint32_t records = (static_cast<std::uint32_t>(registers[RegisterDefinitions::file_segment].value) * modbus::max_num_of_records) +
+                                      registers[RegisterDefinitions::record_counter].value;
+        const std::uint32_t size = records * getActiveRecordSize();
+        digest = crc32Update(crc32_init, file.data.p_data, (size < file.data.size) ? size : file.data.size);
+    }
+    setDigestRegisters(crc32Final(digest));
+}
+
+void ServerResources::setDigestRegisters(const std::uint32_t value)
+{
+    registers[RegisterDefinitions::file_digest_high].value = static_cast<std::uint16_t>(value >> 16);
+    registers[RegisterDefinitions::file_digest_low].value = static_cast<std::uint16_t>(value);
+    image.update(RegisterDefinitions::file_digest_high, registers[RegisterDefinitions::file_digest_high]);
+    image.update(RegisterDefinitions::file_digest_low, registers[RegisterDefinitions::file_digest_low]);
+}
+
+std::uint64_t ServerResources::getRecordOffset(const FileService& service) const
+{
+    // record map describes the actual segment only
+    const std::uint64_t segment = (service.file_id == FileDefinitions::record_map) ? 0 : registers[RegisterDefinitions::file_segment].value;
+    return ((segment * modbus::max_num_of_records) + service.record_id) * getActiveRecordSize();
+}
+
+int ServerResources::getFileIndex(const std::uint16_t file_id) const
+{
+    if ((file_id < modbus::files_offset) || (static_cast<size_t>(file_id - modbus::files_offset) >= files.size())) { return not_found; }
+    return file_id - modbus::files_offset;
+}
+
+bool ServerResources::isWriteAllowed(const std::uint16_t index, const std::uint16_t value) const
+{
+    if (!registers[index].attributes.property_write) { return false; }
+    if (index == RegisterDefinitions::record_size) { return (value != 0) && (value <= record_size); }
+    if (index == RegisterDefinitions::gateway_buffer_size) { return value <= modbus::max_adu_size; }
     return true;
 }
 
@@ -12,20 +12,33 @@
 namespace sm
 {
 ServerExceptions ModbusServer::serverTask(std::uint8_t* data, const std::uint8_t length)
+{
+    const bool broadcast = (data[0] == modbus::broadcast_address);
+    if ((address != data[0]) && !broadcast)
+    {
+        // request for another server on the bus
+        transmit_length = 0;
+        return ServerExceptions::address_not_recognized;
+    }
+    ServerExceptions result = processRequest(data, length);
+    // broadcast request is executed by every server and nobody responds
+    if (broadcast)
+    {
+        transmit_length = 0;
+    }
+    return result;
+}
+
+ServerExceptions ModbusServer::processRequest(std::uint8_t* data, const std::uint8_t length)
 {
     //recend what we have by default
     transmit_length = length;
 
-    std::uint8_t received_address = data[0];
     std::uint8_t received_function = data[1];
 
-    if (address != received_address)
-    {
-        return ServerExceptions::address_not_recognized;
-    }
     std::uint16_t actual_crc = crc16(data, length - modbus::crc_size);
     std::uint16_t received_crc = data[length - modbus::crc_size];
-    received_crc |= data[length - modbus::crc_size + 1];
+    received_crc |= static_cast<std::uint16_t>(data[length - modbus::crc_size + 1]) << 8;
     if (received_crc != actual_crc)
     {
         generateException(data, modbus::Exceptions::exception_3);
@@ -46,6 +59,14 @@ ServerExceptions ModbusServer::serverTask(std::uint8_t* data, const std::uint8_t
             exception = readRegister(data + required_offset, generated_length);
             break;
 
+        case static_cast<std::uint8_t>(modbus::FunctionCodes::write_regs):
+            exception = writeRegisters(data + required_offset, generated_length);
+            break;
+
+        case static_cast<std::uint8_t>(modbus::FunctionCodes::read_write_regs):
+            exception = readWriteRegisters(data + required_offset, generated_length);
+            break;
+
         case static_cast<std::uint8_t>(modbus::FunctionCodes::write_file):
             exception = writeFile(data + required_offset);
             break;
@@ -68,13 +89,70 @@ ServerExceptions ModbusServer::serverTask(std::uint8_t* data, const std::uint8_t
         if (generated_length != 0)
         {
             std::uint16_t new_crc = crc16(data, required_offset + generated_length);
-            server_resources.insertHalfWord(data + required_offset +  generated_length, new_crc);
+            // crc is transmitted low byte first
+            data[required_offset + generated_length] = static_cast<std::uint8_t>(new_crc & 0xFF);
+            data[required_offset + generated_length + 1] = static_cast<std::uint8_t>((new_crc & 0xFF00) >> 8);
             transmit_length = required_offset + generated_length + modbus::crc_size;
         }
         return ServerExceptions::no_error;
     }
 }
 
+std::uint16_t ModbusServer::getRequestLength(const std::uint8_t* data, const std::uint8_t available)
+{
+    const std::uint8_t header_size = modbus::address_size + modbus::function_size;
+    if (available < header_size) { return 0; }
+    switch (data[1])
+    {
+        case static_cast<std::uint8_t>(modbus::FunctionCodes::read_file):
+        case static_cast<std::uint8_t>(modbus::FunctionCodes::write_file):
+            // byte counter follows function code
+            if (available < (header_size + 1)) { return 0; }
+            return header_size + 1 + data[header_size] + modbus::crc_size;
+
+        case static_cast<std::uint8_t>(modbus::FunctionCodes::write_regs):
+            // byte counter follows address and quantity
+            if (available < (header_size + 5)) { return 0; }
+            return header_size + 5 + data[header_size + 4] + modbus::crc_size;
+
+        case static_cast<std::uint8_t>(modbus::FunctionCodes::read_write_regs):
+            // byte counter follows read address, read quantity, write address and write quantity
+            if (available < (header_size + 9)) { return 0; }
+            return header_size + 9 + data[header_size + 8] + modbus::crc_size;
+
+        default:
+            // register access and ping requests have fixed size
+            return header_size + modbus::request_rw_reg_pdu_size - modbus::function_size + modbus::crc_size;
+    }
+}
+
+std::uint16_t ModbusServer::getResponseLength(const std::uint8_t* data, const std::uint8_t available, const std::uint16_t default_length)
+{
+    const std::uint8_t header_size = modbus::address_size + modbus::function_size;
+    if (available < header_size) { return 0; }
+    if (data[1] & modbus::function_error_mask)
+    {
+        return modbus::address_size + modbus::exception_pdu_size + modbus::crc_size;
+    }
+    switch (data[1])
+    {
+        case static_cast<std::uint8_t>(modbus::FunctionCodes::read_regs):
+        case static_cast<std::uint8_t>(modbus::FunctionCodes::read_write_regs):
+        case static_cast<std::uint8_t>(modbus::FunctionCodes::read_file):
+        case static_cast<std::uint8_t>(modbus::FunctionCodes::write_file):
+            // byte counter follows function code
+            if (available < (header_size + 1)) { return 0; }
+            return header_size + 1 + data[header_size] + modbus::crc_size;
+
+        case static_cast<std::uint8_t>(modbus::FunctionCodes::write_reg):
+        case static_cast<std::uint8_t>(modbus::FunctionCodes::write_regs):
+            return modbus::address_size + modbus::response_write_reg_pdu_size + modbus::crc_size;
+
+        default:
+            return default_length;
+    }
+}
+
 modbus::Exceptions ModbusServer::writeRegister(std::uint8_t* data)
 {
     std::uint16_t address = server_resources.extractHalfWord(data);
@@ -95,7 +173,7 @@ modbus::Exceptions ModbusServer::readRegister(std::uint8_t* data, std::uint8_t&
     std::uint16_t address = server_resources.extractHalfWord(data);
     std::uint16_t quantity = server_resources.extractHalfWord(data + sizeof(std::uint16_t));
 
-    if ((quantity < modbus::min_amount_of_regs) && (quantity > modbus::max_amount_of_regs))
+    if ((quantity < modbus::min_amount_of_regs) || (quantity > modbus::max_amount_of_regs))
     {
         return modbus::Exceptions::exception_3;
     }
@@ -112,6 +190,60 @@ modbus::Exceptions ModbusServer::readRegister(std::uint8_t* data, std::uint8_t&
     }
 }
 
+modbus::Exceptions ModbusServer::writeRegisters(std::uint8_t* data, std::uint8_t& length)
+{
+    std::uint16_t address = server_resources.extractHalfWord(data);
+    std::uint16_t quantity = server_resources.extractHalfWord(data + sizeof(std::uint16_t));
+    std::uint8_t byte_counter = data[sizeof(std::uint16_t) * 2];
+
+    if ((quantity < modbus::min_amount_of_regs) || (quantity > modbus::max_amount_of_write_regs) || (byte_counter != (quantity * 2)))
+    {
+        return modbus::Exceptions::exception_3;
+    }
+    else
+    {
+        if (server_resources.writeRegisters(address, quantity, data + (sizeof(std::uint16_t) * 2) + 1))
+        {
+            // response is address and quantity, already in buffer
+            length = sizeof(std::uint16_t) * 2;
+            return modbus::Exceptions::no_exception;
+        }
+        else
+        {
+            return modbus::Exceptions::exception_4;
+        }
+    }
+}
+
+modbus::Exceptions ModbusServer::readWriteRegisters(std::uint8_t* data, std::uint8_t& length)
+{
+    std::uint16_t read_address = server_resources.extractHalfWord(data);
+    std::uint16_t read_quantity = server_resources.extractHalfWord(data + sizeof(std::uint16_t));
+    std::uint16_t write_address = server_resources.extractHalfWord(data + (sizeof(std::uint16_t) * 2));
+    std::uint16_t write_quantity = server_resources.extractHalfWord(data + (sizeof(std::uint16_t) * 3));
+    std::uint8_t byte_counter = data[sizeof(std::uint16_t) * 4];
+
+    if ((read_quantity < modbus::min_amount_of_regs) || (read_quantity > modbus::max_amount_of_regs) ||
+        (write_quantity < modbus::min_amount_of_regs) || (write_quantity > modbus::max_amount_of_read_write_regs) ||
+        (byte_counter != (write_quantity * 2)))
+    {
+        return modbus::Exceptions::exception_3;
+    }
+    // write is performed before read
+    if (!server_resources.writeRegisters(write_address, write_quantity, data + (sizeof(std::uint16_t) * 4) + 1))
+    {
+        return modbus::Exceptions::exception_4;
+    }
+    if (server_resources.readRegister(read_address, read_quantity, data, length))
+    {
+        return modbus::Exceptions::no_exception;
+    }
+    else
+    {
+        return modbus::Exceptions::exception_2;
+    }
+}
+
 modbus::Exceptions ModbusServer::writeFile(std::uint8_t* data)
 {
     std::uint8_t byte_counter = data[0];
@@ -164,14 +296,19 @@ modbus::Exceptions ModbusServer::readFile(std::uint8_t* data, std::uint8_t& leng
 }
 
 void ModbusServer::generateException(std::uint8_t* data, const modbus::Exceptions exception)
+{
+    transmit_length = buildException(data, exception);
+};
+
+std::uint8_t ModbusServer::buildException(std::uint8_t* data, const modbus::Exceptions exception)
 {
     data[1] |= modbus::function_error_mask;
     data[2] = static_cast<std::uint8_t>(exception);
-    std::uint16_t crc =  crc16(data, modbus::exception_pdu_size);
+    std::uint16_t crc =  crc16(data, modbus::address_size + modbus::exception_pdu_size);
     data[3] = static_cast<std::uint8_t>(crc & 0xFF);
     data[4] = static_cast<std::uint8_t>((crc & 0xFF00) >> 8);
-    transmit_length = modbus::address_size + modbus::exception_pdu_size + modbus::crc_size;
-};
+    return modbus::address_size + modbus::exception_pdu_size + modbus::crc_size;
+}
 
 std::uint16_t ModbusServer::crc16(const std::uint8_t* data, const std::uint16_t length)
 {
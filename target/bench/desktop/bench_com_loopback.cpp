@@ -0,0 +1,142 @@
+/**
+ * @file bench_com_loopback.cpp
+ *
+ * @brief DesktopCom receive/transmit rate over pseudo terminal loopback
+ *
+ * @author
+ *
+ */
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include "platform.hpp"
+
+PlatformSupport platform_support;
+
+namespace
+{
+
+bool readExact(const int fd, std::uint8_t* data, const size_t amount)
+{
+    size_t bytes_read = 0;
+    while (bytes_read != amount)
+    {
+        ssize_t result = read(fd, data + bytes_read, amount - bytes_read);
+        if (result <= 0)
+        {
+            return false;
+        }
+        bytes_read += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+void onComEvent(void* context) { static_cast<DesktopWaitPolicy*>(context)->notify(); }
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const size_t frame_size = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 8;
+    const int num_of_frames = (argc > 2) ? std::atoi(argv[2]) : 20000;
+    if ((frame_size == 0) || (frame_size > modbus::max_adu_size))
+    {
+        std::printf("frame size should be in range 1..%u\n", modbus::max_adu_size);
+        return 1;
+    }
+
+    int master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master_fd < 0) || (grantpt(master_fd) != 0) || (unlockpt(master_fd) != 0))
+    {
+        std::printf("failed to create pseudo terminal\n");
+        return 1;
+    }
+    std::string path = ptsname(master_fd);
+    // raw mode for the link, line settings are shared by all descriptors of the terminal
+    int slave_fd = open(path.c_str(), O_RDWR | O_NOCTTY);
+    termios tty;
+    tcgetattr(slave_fd, &tty);
+    cfmakeraw(&tty);
+    tcsetattr(slave_fd, TCSANOW, &tty);
+
+    sp::PortConfig config;
+    config.baudrate = sp::PortBaudRate::BD_57600;
+    config.timeout_ms = 2000;
+    platform_support.setPath(path);
+    platform_support.setConfig(config);
+
+    DesktopWaitPolicy wait_policy;
+    DesktopCom com;
+    com.setEventHook(sm::EventHook{&onComEvent, &wait_policy});
+    com.init();
+    if (!com.isConfigured())
+    {
+        return 1;
+    }
+
+    std::array<std::uint8_t, modbus::max_adu_size> node_buffer{};
+    std::atomic<bool> echo_stop{false};
+    std::thread echo(
+        [&]()
+        {
+            for (int i = 0; (i < num_of_frames) && !echo_stop.load(std::memory_order_relaxed); ++i)
+            {
+                com.readData(node_buffer.data(), frame_size);
+                while (!com.isReady())
+                {
+                    if (echo_stop.load(std::memory_order_relaxed))
+                    {
+                        return;
+                    }
+                    wait_policy.wait();
+                }
+                com.sendData(node_buffer.data(), frame_size);
+            }
+        });
+
+    std::array<std::uint8_t, modbus::max_adu_size> request{};
+    std::array<std::uint8_t, modbus::max_adu_size> response{};
+    bool failed = false;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_of_frames; ++i)
+    {
+        request[0] = static_cast<std::uint8_t>(i);
+        if ((write(master_fd, request.data(), frame_size) != static_cast<ssize_t>(frame_size)) || !readExact(master_fd, response.data(), frame_size))
+        {
+            std::printf("loopback failed on frame %d\n", i);
+            failed = true;
+            break;
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+    if (failed)
+    {
+        // echo thread waits for frames which never come
+        echo_stop.store(true, std::memory_order_relaxed);
+        wait_policy.notify();
+    }
+    echo.join();
+    if (failed)
+    {
+        close(slave_fd);
+        close(master_fd);
+        return 1;
+    }
+
+    const double seconds = std::chrono::duration<double>(stop - start).count();
+    const ComCounters counters = com.getCounters();
+    std::printf("frame size %zu bytes, %d frames in %.3f s\n", frame_size, num_of_frames, seconds);
+    std::printf("rx %10.1f frames/s %12.1f bytes/s\n", counters.rx_frames / seconds, counters.rx_bytes / seconds);
+    std::printf("tx %10.1f frames/s %12.1f bytes/s\n", counters.tx_frames / seconds, counters.tx_bytes / seconds);
+    close(slave_fd);
+    close(master_fd);
+    return 0;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file bench_registers.cpp
+ *
+ * @brief holding register read cost, per register loop against the precomputed register image
+ *
+ * @author
+ *
+ */
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include "sm_resources.hpp"
+#include "../../../core/common/sm_modbus.hpp"
+
+constexpr std::uint32_t iterations = 1000000;
+// register map size of a device with the full read window
+constexpr size_t large_map_size = 125;
+
+struct LargeMap
+{
+    std::array<sm::RegisterInfo, large_map_size> registers;
+    sm::RegisterImage<large_map_size> image;
+};
+
+// previous readRegister implementation, kept as reference
+bool readLoop(const LargeMap& map, const std::uint16_t offset, const std::uint16_t quantity, std::uint8_t* data, std::uint8_t& size)
+{
+    if ((offset + quantity) > map.registers.size()) { return false; }
+    data[0] = static_cast<std::uint8_t>((quantity * 2));
+    int counter = 1;
+    for (int i = 0; i < quantity; ++i)
+    {
+        if (!map.registers[offset + i].attributes.property_read) { return false; }
+        sm::ServerResources::insertHalfWord(&data[counter], map.registers[offset + i].value);
+        counter += 2;
+    }
+    size = data[0] + 1;
+    return true;
+}
+
+bool readImage(const LargeMap& map, const std::uint16_t offset, const std::uint16_t quantity, std::uint8_t* data, std::uint8_t& size)
+{
+    if (((offset + quantity) > map.image.size()) || !map.image.isReadable(offset, quantity)) { return false; }
+    data[0] = static_cast<std::uint8_t>((quantity * 2));
+    map.image.copy(offset, quantity, &data[1]);
+    size = data[0] + 1;
+    return true;
+}
+
+template <typename Read>
+void run(const char* name, Read read)
+{
+    std::array<std::uint8_t, modbus::max_adu_size> data{};
+    std::uint8_t size = 0;
+    std::uint32_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (std::uint32_t i = 0; i < iterations; ++i)
+    {
+        if (read(data.data(), size)) { checksum += data[size - 1]; }
+    }
+    auto stop = std::chrono::steady_clock::now();
+    const double nanoseconds = std::chrono::duration<double, std::nano>(stop - start).count() / iterations;
+    std::printf("%-28s %8.1f ns/read (checksum %u)\n", name, nanoseconds, checksum);
+}
+
+int main()
+{
+    const sm::Attributes read_only{true, false, false};
+    LargeMap map;
+    for (size_t i = 0; i < large_map_size; ++i)
+    {
+        map.registers[i] = sm::RegisterInfo(read_only, static_cast<std::uint16_t>(i * 3));
+        map.image.update(i, map.registers[i]);
+    }
+    sm::ServerResources resources(208);
+    const std::uint16_t status = modbus::holding_regs_offset + sm::RegisterDefinitions::status;
+    const std::uint16_t all = static_cast<std::uint16_t>(sm::RegisterDefinitions::getSize());
+
+    run("server, 1 register", [&](std::uint8_t* data, std::uint8_t& size) { return resources.readRegister(status, 1, data, size); });
+    run("server, all registers", [&](std::uint8_t* data, std::uint8_t& size)
+        { return resources.readRegister(modbus::holding_regs_offset, all, data, size); });
+    run("loop, 1 register", [&](std::uint8_t* data, std::uint8_t& size) { return readLoop(map, 60, 1, data, size); });
+    run("image, 1 register", [&](std::uint8_t* data, std::uint8_t& size) { return readImage(map, 60, 1, data, size); });
+    run("loop, 125 registers", [&](std::uint8_t* data, std::uint8_t& size) { return readLoop(map, 0, 125, data, size); });
+    run("image, 125 registers", [&](std::uint8_t* data, std::uint8_t& size) { return readImage(map, 0, 125, data, size); });
+    return 0;
+}
@@ -0,0 +1,346 @@
+/**
+ * @file bench_replay.cpp
+ *
+ * @brief requests from captured trace fed into ModbusServer::serverTask, responses and processing time are compared
+ *
+ * @author
+ *
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "sm_server.hpp"
+#include "../../../core/common/sm_common.hpp"
+#include "../../../core/common/sm_pcap.hpp"
+
+namespace
+{
+
+// capture with microsecond timestamps is accepted too
+constexpr std::uint32_t pcap_magic_us = 0xA1B2C3D4;
+// processing time may grow by this part before it is reported as regression
+constexpr double default_tolerance = 0.2;
+// first mismatches are printed in full, the rest is only counted
+constexpr int max_printed_mismatches = 5;
+
+struct TraceFrame
+{
+    std::chrono::nanoseconds time{0};
+    std::vector<std::uint8_t> request;
+    std::vector<std::uint8_t> response; // empty if nothing was captured
+};
+
+struct ReplayOptions
+{
+    std::string trace;
+    bool recorded_speed = false;
+    int passes = 1;
+    std::uint8_t record_size = 240;
+    std::uint32_t application_size = 64 * 1024;
+    std::uint32_t metadata_size = 4 * 1024;
+    std::string baseline_out;
+    std::string baseline_in;
+    double tolerance = default_tolerance;
+};
+
+// same setup as device farm, traces captured with the farm are replayed without mismatches
+class ReplayDevice
+{
+public:
+    ReplayDevice(const std::uint8_t address, const ReplayOptions& options) :
+        server(address, options.record_size), application(options.application_size, 0xFF), metadata(options.metadata_size, 0xFF)
+    {
+        const sm::Attributes read_write{true, true, false};
+        const sm::Attributes read_only{true, false, false};
+        sm::ServerResources& resources = server.getResources();
+        resources.setRegister(sm::RegisterDefinitions::status, sm::RegisterInfo(read_only, address));
+        resources.setFile(sm::FileDefinitions::application, sm::FileInfo(read_write, sm::FileData{application.data(), options.application_size}));
+        resources.setFile(sm::FileDefinitions::metadata, sm::FileInfo(read_write, sm::FileData{metadata.data(), options.metadata_size}));
+    }
+    sm::ModbusServer& getServer() { return server; }
+
+private:
+    sm::ModbusServer server;
+    std::vector<std::uint8_t> application;
+    std::vector<std::uint8_t> metadata;
+};
+
+struct FunctionTimes
+{
+    std::vector<std::int64_t> samples; // nanoseconds
+    std::int64_t getQuantile(const double quantile) const
+    {
+        if (samples.empty())
+        {
+            return 0;
+        }
+        const size_t index = std::min(samples.size() - 1, static_cast<size_t>(quantile * static_cast<double>(samples.size())));
+        return samples[index];
+    }
+};
+
+bool loadTrace(const std::string& path, std::vector<TraceFrame>& frames)
+{
+    std::ifstream file(path, std::ifstream::binary);
+    sm::PcapFileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    {
+        std::printf("%s: not a pcap file\n", path.c_str());
+        return false;
+    }
+    if (((header.magic != sm::pcap_magic_ns) && (header.magic != pcap_magic_us)) || (header.link_type != sm::pcap_linktype_user0))
+    {
+        std::printf("%s: only captures of sm::FrameCapture in host byte order are supported\n", path.c_str());
+        return false;
+    }
+    const std::int64_t fraction_ns = (header.magic == sm::pcap_magic_ns) ? 1 : 1000;
+    sm::PcapRecordHeader record;
+    std::vector<std::uint8_t> packet;
+    while (file.read(reinterpret_cast<char*>(&record), sizeof(record)))
+    {
+        packet.resize(record.captured_length);
+        if (!file.read(reinterpret_cast<char*>(packet.data()), packet.size()))
+        {
+            break;
+        }
+        // truncated frames and frames without address and function are useless for replay
+        if ((packet.size() < 3) || (record.captured_length != record.original_length))
+        {
+            continue;
+        }
+        const auto direction = static_cast<sm::CaptureDirection>(packet[0]);
+        if (direction == sm::CaptureDirection::request)
+        {
+            TraceFrame frame;
+            frame.time = std::chrono::nanoseconds(static_cast<std::int64_t>(record.seconds) * 1000000000 + record.nanoseconds * fraction_ns);
+            frame.request.assign(packet.begin() + 1, packet.end());
+            frames.push_back(std::move(frame));
+        }
+        else if (!frames.empty() && frames.back().response.empty())
+        {
+            frames.back().response.assign(packet.begin() + 1, packet.end());
+        }
+    }
+    return true;
+}
+
+void printFrame(const char* name, const std::uint8_t* data, const size_t length)
+{
+    std::printf("  %-9s", name);
+    for (size_t i = 0; i < length; ++i)
+    {
+        std::printf(" %02X", data[i]);
+    }
+    std::printf("\n");
+}
+
+bool parseOptions(int argc, char* argv[], ReplayOptions& options)
+{
+    if (argc < 2)
+    {
+        return false;
+    }
+    options.trace = argv[1];
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+        const bool has_value = (i + 1) < argc;
+        if (option == "-r")
+        {
+            options.recorded_speed = true;
+        }
+        else if ((option == "-n") && has_value)
+        {
+            options.passes = std::max(1, std::atoi(argv[++i]));
+        }
+        else if ((option == "-s") && has_value)
+        {
+            options.record_size = static_cast<std::uint8_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if ((option == "-f") && has_value)
+        {
+            options.application_size = static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if ((option == "-w") && has_value)
+        {
+            options.baseline_out = argv[++i];
+        }
+        else if ((option == "-c") && has_value)
+        {
+            options.baseline_in = argv[++i];
+        }
+        else if ((option == "-t") && has_value)
+        {
+            options.tolerance = std::atof(argv[++i]) / 100.0;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    ReplayOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        std::printf("usage: %s <trace.pcap> [-r] [-n passes] [-s record size] [-f application file size] [-w baseline] [-c baseline] [-t tolerance %%]\n"
+                    "  -r  keep recorded time between requests, default is maximal speed\n"
+                    "  -w  write median and p99 processing time of every function code to file\n"
+                    "  -c  compare with baseline file, exit code is 1 if processing time grew above tolerance (default 20%%)\n",
+                    argv[0]);
+        return 1;
+    }
+    std::vector<TraceFrame> frames;
+    if (!loadTrace(options.trace, frames))
+    {
+        return 1;
+    }
+    if (frames.empty())
+    {
+        std::printf("%s: no requests\n", options.trace.c_str());
+        return 1;
+    }
+
+    std::map<std::uint8_t, FunctionTimes> times;
+    std::uint64_t matched = 0;
+    std::uint64_t mismatched = 0;
+    std::uint64_t unanswered = 0; // trace has no response, server responded
+    std::uint64_t missing = 0;    // trace has response, server did not respond
+    std::array<std::uint8_t, modbus::max_adu_size + 3> buffer{};
+    std::chrono::nanoseconds processing{0};
+    for (int pass = 0; pass < options.passes; ++pass)
+    {
+        // server state is built from the trace only, every pass starts from the same state
+        std::map<std::uint8_t, std::unique_ptr<ReplayDevice>> devices;
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto& frame : frames)
+        {
+            if (options.recorded_speed)
+            {
+                std::this_thread::sleep_until(start + (frame.time - frames.front().time));
+            }
+            const std::uint8_t address = frame.request[0];
+            if ((address > modbus::max_rtu_address) || (frame.request.size() > modbus::max_adu_size))
+            {
+                continue;
+            }
+            if ((address != modbus::broadcast_address) && (devices.count(address) == 0))
+            {
+                devices[address] = std::make_unique<ReplayDevice>(address, options);
+            }
+            for (auto& device : devices)
+            {
+                if ((address != modbus::broadcast_address) && (device.first != address))
+                {
+                    continue;
+                }
+                sm::ModbusServer& server = device.second->getServer();
+                std::memcpy(buffer.data(), frame.request.data(), frame.request.size());
+                const auto begin = std::chrono::steady_clock::now();
+                server.serverTask(buffer.data(), static_cast<std::uint8_t>(frame.request.size()));
+                const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin);
+                processing += duration;
+                times[frame.request[1]].samples.push_back(duration.count());
+                if (address == modbus::broadcast_address)
+                {
+                    continue;
+                }
+                const size_t length = server.getTransmitBufferSize();
+                if (frame.response.empty())
+                {
+                    unanswered += (length != 0) ? 1 : 0;
+                }
+                else if (length == 0)
+                {
+                    ++missing;
+                }
+                else if ((length == frame.response.size()) && std::equal(frame.response.begin(), frame.response.end(), buffer.begin()))
+                {
+                    ++matched;
+                }
+                else
+                {
+                    if (mismatched < max_printed_mismatches)
+                    {
+                        std::printf("response mismatch, request %zu of the trace\n", static_cast<size_t>(&frame - frames.data()));
+                        printFrame("request", frame.request.data(), frame.request.size());
+                        printFrame("recorded", frame.response.data(), frame.response.size());
+                        printFrame("replayed", buffer.data(), length);
+                    }
+                    ++mismatched;
+                }
+            }
+        }
+    }
+
+    std::uint64_t total = 0;
+    std::printf("%zu requests, %d passes, %.3f ms in serverTask\n", frames.size(), options.passes, static_cast<double>(processing.count()) / 1e6);
+    std::printf("responses: %llu matched, %llu different, %llu missing, %llu not in trace\n", static_cast<unsigned long long>(matched),
+                static_cast<unsigned long long>(mismatched), static_cast<unsigned long long>(missing), static_cast<unsigned long long>(unanswered));
+    std::printf("function   frames     min ns     p50 ns     p99 ns     max ns\n");
+    for (auto& function : times)
+    {
+        auto& samples = function.second.samples;
+        std::sort(samples.begin(), samples.end());
+        total += samples.size();
+        std::printf("0x%02X   %10zu %10lld %10lld %10lld %10lld\n", function.first, samples.size(), static_cast<long long>(samples.front()),
+                    static_cast<long long>(function.second.getQuantile(0.5)), static_cast<long long>(function.second.getQuantile(0.99)),
+                    static_cast<long long>(samples.back()));
+    }
+    if (processing.count() > 0)
+    {
+        std::printf("%.1f frames/s in serverTask\n", static_cast<double>(total) * 1e9 / static_cast<double>(processing.count()));
+    }
+
+    if (!options.baseline_out.empty())
+    {
+        std::ofstream baseline(options.baseline_out, std::ofstream::trunc);
+        for (const auto& function : times)
+        {
+            baseline << static_cast<unsigned>(function.first) << " " << function.second.getQuantile(0.5) << " " << function.second.getQuantile(0.99) << "\n";
+        }
+    }
+    bool regression = (mismatched != 0) || (missing != 0) || (unanswered != 0);
+    if (!options.baseline_in.empty())
+    {
+        std::ifstream baseline(options.baseline_in);
+        if (!baseline)
+        {
+            std::printf("%s: baseline not found\n", options.baseline_in.c_str());
+            return 1;
+        }
+        unsigned code = 0;
+        long long base_p50 = 0;
+        long long base_p99 = 0;
+        while (baseline >> code >> base_p50 >> base_p99)
+        {
+            auto function = times.find(static_cast<std::uint8_t>(code));
+            if (function == times.end())
+            {
+                continue;
+            }
+            // median is compared, p99 of short traces is too noisy for pass/fail
+            const long long p50 = function->second.getQuantile(0.5);
+            const double change = (base_p50 > 0) ? (static_cast<double>(p50 - base_p50) / static_cast<double>(base_p50)) : 0.0;
+            const bool slower = change > options.tolerance;
+            std::printf("0x%02X p50 %lld -> %lld ns (%+.1f%%)%s\n", code, base_p50, p50, change * 100.0, slower ? " REGRESSION" : "");
+            regression = regression || slower;
+        }
+    }
+    return regression ? 1 : 0;
+}
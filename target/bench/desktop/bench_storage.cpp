@@ -0,0 +1,69 @@
+/**
+ * @file bench_storage.cpp
+ *
+ * @brief throughput of the memory-mapped file storage for every msync policy
+ *
+ * @author
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "storage.hpp"
+#include "../../../core/common/sm_modbus.hpp"
+
+constexpr std::uint8_t record_size = 208;
+constexpr std::uint16_t num_of_records = modbus::max_num_of_records;
+constexpr std::uint32_t application_file_size = record_size * num_of_records;
+constexpr std::uint32_t metadata_file_size = 4096;
+
+struct BenchCase
+{
+    const char* name;
+    SyncPolicy policy;
+    std::uint32_t records_per_sync;
+};
+
+int main(int argc, char* argv[])
+{
+    const std::string dir = (argc > 1) ? argv[1] : ".";
+    const BenchCase cases[] = {
+        {"per record", SyncPolicy::per_record, 1},
+        {"per 16 records", SyncPolicy::per_n_records, 16},
+        {"per 256 records", SyncPolicy::per_n_records, 256},
+        {"on complete", SyncPolicy::on_complete, 1},
+    };
+    std::vector<std::uint8_t> record(record_size);
+    std::printf("%u records x %u bytes per transfer\n", num_of_records, record_size);
+    for (const auto& bench : cases)
+    {
+        DesktopStorage storage;
+        sm::ServerResources resources(record_size);
+        if (!storage.open(dir, application_file_size, metadata_file_size))
+        {
+            return 1;
+        }
+        storage.attach(resources);
+        storage.setSyncPolicy(bench.policy, bench.records_per_sync);
+        resources.writeRegister(modbus::holding_regs_offset + sm::RegisterDefinitions::record_counter, num_of_records);
+        const std::uint32_t syncs_before = storage.getSyncCounter();
+
+        auto start = std::chrono::steady_clock::now();
+        for (std::uint16_t i = 0; i < num_of_records; ++i)
+        {
+            record[0] = static_cast<std::uint8_t>(i);
+            sm::FileService service(sm::FileDefinitions::application, i, record_size / 2);
+            resources.writeFile(service, record.data());
+        }
+        auto stop = std::chrono::steady_clock::now();
+        storage.close();
+
+        const double seconds = std::chrono::duration<double>(stop - start).count();
+        const double megabytes = static_cast<double>(application_file_size) / (1024.0 * 1024.0);
+        std::printf("%-16s %10.1f records/s %8.2f MiB/s %6u msync calls\n", bench.name, num_of_records / seconds, megabytes / seconds,
+                    storage.getSyncCounter() - syncs_before);
+    }
+    return 0;
+}
@@ -0,0 +1,185 @@
+/**
+ * @file fleet.cpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <system_error>
+#include "../../../core/client/inc/sm_client.hpp"
+#include "../../../core/client/inc/sm_fleet.hpp"
+#include "../../../core/client/inc/sm_progress.hpp"
+
+namespace
+{
+const char* getStateName(const sm::FleetJobState state)
+{
+    switch (state)
+    {
+        case sm::FleetJobState::pending:
+            return "pending";
+        case sm::FleetJobState::running:
+            return "running";
+        case sm::FleetJobState::done:
+            return "done";
+        default:
+            return "failed";
+    }
+}
+
+bool parseNumber(const char* text, unsigned long& value)
+{
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtoul(text, &end, 10);
+    return (errno == 0) && (end != text) && (*end == '\0') && (text[0] != '-');
+}
+
+bool getBaudRate(const unsigned long value, sp::PortBaudRate& baudrate)
+{
+    switch (value)
+    {
+        case 9600:
+            baudrate = sp::PortBaudRate::BD_9600;
+            return true;
+        case 19200:
+            baudrate = sp::PortBaudRate::BD_19200;
+            return true;
+        case 38400:
+            baudrate = sp::PortBaudRate::BD_38400;
+            return true;
+        case 57600:
+            baudrate = sp::PortBaudRate::BD_57600;
+            return true;
+        case 115200:
+            baudrate = sp::PortBaudRate::BD_115200;
+            return true;
+        default:
+            return false;
+    }
+}
+
+void printUsage(const char* name)
+{
+    std::printf("usage: %s [-b] [-s baudrate] [-t timeout ms] <manifest>, manifest line: <port> <address> <image> [gateway address]\n", name);
+    std::printf("       -b: devices of the same port with the same image are updated by one broadcast transfer\n");
+    std::printf("       -s: 9600, 19200, 38400, 57600 or 115200, default 57600\n");
+    std::printf("       -t: response timeout, default 2000\n");
+}
+
+void printProgress(const int percent, const sm::FleetProgress& progress)
+{
+    std::printf("\rprogress %3d %%, done %zu, failed %zu, running %zu of %zu", percent, progress.done, progress.failed, progress.running, progress.total);
+    std::fflush(stdout);
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    bool broadcast = false;
+    unsigned long baudrate = 57600;
+    unsigned long timeout_ms = 2000;
+    sp::PortConfig config;
+    int arg = 1;
+    for(; (arg < argc) && (argv[arg][0] == '-'); ++arg)
+    {
+        const std::string option = argv[arg];
+        if(option == "-b")
+        {
+            broadcast = true;
+            continue;
+        }
+        const bool has_value = (arg + 1) < argc;
+        if((option == "-s") && has_value && parseNumber(argv[arg + 1], baudrate) && getBaudRate(baudrate, config.baudrate))
+        {
+            ++arg;
+            continue;
+        }
+        if((option == "-t") && has_value && parseNumber(argv[arg + 1], timeout_ms) && (timeout_ms != 0) && (timeout_ms <= 60000))
+        {
+            ++arg;
+            continue;
+        }
+        printUsage(argv[0]);
+        return 1;
+    }
+    if((arg + 1) != argc)
+    {
+        printUsage(argv[0]);
+        return (argc < 2) ? 0 : 1;
+    }
+    getBaudRate(baudrate, config.baudrate);
+    config.timeout_ms = static_cast<int>(timeout_ms);
+
+    sm::FleetUpdater updater(config);
+    if(broadcast)
+    {
+        // broadcast pacing is calculated for the same line speed as the port
+        updater.setBroadcast(static_cast<std::uint32_t>(baudrate));
+    }
+    // every image is loaded once and shared by all devices using it
+    std::map<std::string, sm::FleetImage> images;
+    std::ifstream manifest(argv[arg]);
+    if(!manifest)
+    {
+        std::cout <<"failed to open manifest, exit...\n";
+        return 0;
+    }
+    std::string line;
+    while(std::getline(manifest, line))
+    {
+        std::istringstream stream(line);
+        sm::FleetJob job;
+        std::string image_path;
+        unsigned address = 0;
+        unsigned gateway = 0;
+        if(line.empty() || (line[0] == '#') || !(stream >> job.port >> address >> image_path))
+        {
+            continue;
+        }
+        stream >> gateway;
+        if((address < modbus::min_rtu_address) || (address > modbus::max_rtu_address) || (gateway > modbus::max_rtu_address))
+        {
+            std::cout <<"out of range address in line: "<<line<<"\n";
+            continue;
+        }
+        auto image = images.find(image_path);
+        if(image == images.end())
+        {
+            image = images.emplace(image_path, sm::FleetUpdater::loadImage(image_path)).first;
+        }
+        job.dev_addr = static_cast<std::uint8_t>(address);
+        job.gateway_addr = static_cast<std::uint8_t>(gateway);
+        job.image = image->second;
+        updater.addJob(job);
+    }
+
+    {
+        // progress is printed from the monitor thread, main thread only waits for the workers
+        sm::ProgressMonitor monitor([&updater](const sm::ProgressReport& report)
+        {
+            printProgress(report.progress, updater.getProgress());
+        });
+        monitor.addSource([&updater]() { return updater.getProgress().progress; });
+        updater.start();
+        updater.wait();
+    }
+    const sm::FleetProgress progress = updater.getProgress();
+    printProgress(progress.progress, progress);
+    std::printf("\n");
+    for(const auto& result : updater.getResults())
+    {
+        std::printf("%s %3u: %s, record size %u, %lld ms%s%s\n", result.job.port.c_str(), result.job.dev_addr, getStateName(result.state),
+                    result.record_size, static_cast<long long>(result.duration.count()), result.error_code ? ", error: " : "",
+                    result.error_code ? result.error_code.message().c_str() : "");
+    }
+}
@@ -0,0 +1,61 @@
+/**
+ * @file ctl.cpp
+ *
+ * @brief sends one request to sm_daemon and prints the response, exit code is 1 if the request failed
+ *
+ * @author
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+int main(int argc, char* argv[])
+{
+    if(argc < 3)
+    {
+        std::printf("usage: sm_daemon_ctl <socket path> <command> [arguments ...]\n");
+        return 1;
+    }
+    sockaddr_un address{};
+    const std::string path = argv[1];
+    if(path.size() >= sizeof(address.sun_path))
+    {
+        std::printf("socket path is too long\n");
+        return 1;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if((fd < 0) || (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0))
+    {
+        std::printf("daemon is not running on %s\n", path.c_str());
+        return 1;
+    }
+    std::string request = argv[2];
+    for(int i = 3; i < argc; ++i)
+    {
+        request += " ";
+        request += argv[i];
+    }
+    request += "\n";
+    std::string response;
+    bool sent = ::send(fd, request.data(), request.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(request.size());
+    char data[512];
+    while(sent && (response.find('\n') == std::string::npos))
+    {
+        const auto received = ::recv(fd, data, sizeof(data), 0);
+        if(received <= 0)
+        {
+            break;
+        }
+        response.append(data, static_cast<size_t>(received));
+    }
+    ::close(fd);
+    std::printf("%s", response.c_str());
+    return (response.compare(0, 2, "ok") == 0) ? 0 : 1;
+}
@@ -0,0 +1,485 @@
+/**
+ * @file daemon.cpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#include "daemon.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "sm_common.hpp"
+#include "sm_error.hpp"
+#include "sm_image.hpp"
+
+namespace sm
+{
+
+namespace
+{
+
+bool parseNumber(const std::string& word, const unsigned long max, unsigned long& value)
+{
+    if (word.empty() || !std::isdigit(static_cast<unsigned char>(word[0])))
+    {
+        return false;
+    }
+    const int base = (word.compare(0, 2, "0x") == 0) ? 16 : 10;
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtoul(word.c_str(), &end, base);
+    return (errno == 0) && (*end == '\0') && (value <= max);
+}
+
+std::string makeError(const std::string& message) { return "error " + message; }
+
+bool sendAll(const int fd, const std::string& data)
+{
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        const auto result = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        sent += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+} // namespace
+
+PortService::PortService(std::string path, const sp::PortConfig& config) :
+    path(std::move(path)), config(config), worker(&PortService::workerThread, this)
+{
+}
+
+PortService::~PortService()
+{
+    {
+        std::lock_guard<std::mutex> lk(queue_mutex);
+        stop = true;
+    }
+    queue_cv.notify_one();
+    worker.join();
+    client.stop();
+}
+
+std::error_code PortService::start()
+{
+    auto error_code = client.start(path);
+    if (!error_code)
+    {
+        error_code = client.configure(config);
+    }
+    return error_code;
+}
+
+std::string PortService::execute(const std::string& command, const std::vector<std::string>& args)
+{
+    DaemonRequest request;
+    request.command = command;
+    request.args = args;
+    auto response = request.response.get_future();
+    {
+        std::lock_guard<std::mutex> lk(queue_mutex);
+        if (stop)
+        {
+            return makeError("daemon is stopping");
+        }
+        queue.push_back(&request);
+    }
+    queue_cv.notify_one();
+    return response.get();
+}
+
+void PortService::workerThread()
+{
+    std::unique_lock<std::mutex> lk(queue_mutex);
+    while (true)
+    {
+        queue_cv.wait(lk, [this] { return stop || !queue.empty(); });
+        // requests queued before stop are still executed, their connections wait for the response
+        if (queue.empty())
+        {
+            return;
+        }
+        DaemonRequest* request = queue.front();
+        queue.pop_front();
+        lk.unlock();
+        request->response.set_value(process(request->command, request->args));
+        lk.lock();
+    }
+}
+
+std::error_code PortService::prepareServer(const std::uint8_t dev_addr, std::uint8_t& record_size)
+{
+    auto server = servers.find(dev_addr);
+    if (server != servers.end())
+    {
+        record_size = server->second;
+        return std::error_code();
+    }
+    client.addServer(dev_addr);
+    auto error_code = client.taskPing(dev_addr);
+    if (error_code)
+    {
+        return error_code;
+    }
+    // record size is configured in the client when this register is read
+    error_code = client.taskReadRegisters(dev_addr, modbus::holding_regs_offset + RegisterDefinitions::record_size, 1);
+    if (error_code)
+    {
+        return error_code;
+    }
+    ServerRegisters registers;
+    client.getLastServerRegList(dev_addr, registers);
+    // servers without files are still usable for register access
+    record_size = registers.values.empty() ? 0 : static_cast<std::uint8_t>(std::min<std::uint16_t>(registers.values[0], modbus::max_rw_file_record_size));
+    if (record_size != 0)
+    {
+        client.setServerRecordMaxSize(dev_addr, record_size);
+    }
+    servers[dev_addr] = record_size;
+    return error_code;
+}
+
+std::string PortService::process(const std::string& command, const std::vector<std::string>& args)
+{
+    if (command == "metrics")
+    {
+        if (args.size() != 1)
+        {
+            return makeError("usage: metrics <port> <path>");
+        }
+        return client.writeMetrics(args[0]) ? "ok" : makeError("metrics file can not be written");
+    }
+    unsigned long value = 0;
+    if (args.empty() || !parseNumber(args[0], modbus::max_rtu_address, value) || (value < modbus::min_rtu_address))
+    {
+        return makeError("invalid address");
+    }
+    const auto dev_addr = static_cast<std::uint8_t>(value);
+    if (command == "forget")
+    {
+        servers.erase(dev_addr);
+        return "ok";
+    }
+    if (command == "ping")
+    {
+        servers.erase(dev_addr);
+    }
+
+    std::vector<std::uint16_t> numbers;
+    std::string file_path;
+    const std::vector<std::string> words(args.begin() + 1, args.end());
+    if ((command == "read") && (words.size() == 2))
+    {
+        numbers.resize(2);
+    }
+    else if ((command == "write") && (words.size() >= 2) && (words.size() <= (modbus::max_amount_of_write_regs + 1U)))
+    {
+        numbers.resize(words.size());
+    }
+    else if ((command == "read_file") && (words.size() == 3))
+    {
+        numbers.resize(2);
+        file_path = words[2];
+    }
+    else if ((command == "write_file") && (words.size() == 2))
+    {
+        numbers.resize(1);
+        file_path = words[1];
+    }
+    else if ((command != "ping") || !words.empty())
+    {
+        return makeError("unknown command or wrong number of arguments");
+    }
+    std::uint32_t file_size = 0;
+    for (size_t i = 0; i < numbers.size(); ++i)
+    {
+        // file size is the only argument which does not fit in 16 bits
+        const unsigned long max = ((command == "read_file") && (i == 1)) ? 0xFFFFFFFFUL : 0xFFFFUL;
+        if (!parseNumber(words[i], max, value))
+        {
+            return makeError("invalid number " + words[i]);
+        }
+        numbers[i] = static_cast<std::uint16_t>(value);
+        file_size = static_cast<std::uint32_t>(value);
+    }
+
+    std::uint8_t record_size = 0;
+    auto error_code = prepareServer(dev_addr, record_size);
+    if (error_code)
+    {
+        return makeError(error_code.message());
+    }
+    std::ostringstream response;
+    response << "ok";
+    if (command == "ping")
+    {
+        response << " " << static_cast<unsigned>(record_size);
+    }
+    else if (command == "read")
+    {
+        if ((numbers[1] < modbus::min_amount_of_regs) || (numbers[1] > modbus::max_amount_of_regs))
+        {
+            return makeError("invalid quantity");
+        }
+        error_code = client.taskReadRegisters(dev_addr, numbers[0], numbers[1]);
+        ServerRegisters registers;
+        client.getLastServerRegList(dev_addr, registers);
+        for (auto register_value : registers.values)
+        {
+            response << " " << register_value;
+        }
+    }
+    else if (command == "write")
+    {
+        if (numbers.size() == 2)
+        {
+            error_code = client.taskWriteRegister(dev_addr, numbers[0], numbers[1]);
+        }
+        else
+        {
+            error_code = client.taskWriteRegisters(dev_addr, numbers[0], std::vector<std::uint16_t>(numbers.begin() + 1, numbers.end()));
+        }
+    }
+    else if (command == "read_file")
+    {
+        auto sink = File::makeDriveSink(file_path);
+        if (!sink)
+        {
+            return makeError(file_path + " can not be created");
+        }
+        error_code = client.taskReadFile(dev_addr, numbers[0], file_size, std::move(sink));
+    }
+    else
+    {
+        auto image = MappedImage::open(file_path);
+        if (!image)
+        {
+            return makeError(file_path + " can not be opened");
+        }
+        if ((record_size == 0) || !client.file.fileWriteSetup(numbers[0], image, record_size))
+        {
+            return makeError(make_error_code(ClientErrors::max_record_length_not_configured).message());
+        }
+        error_code = client.taskWriteFile(dev_addr);
+        if (!error_code)
+        {
+            error_code = client.taskVerifyFile(dev_addr);
+        }
+        client.file.fileDelete();
+    }
+    if (error_code)
+    {
+        // server may be replaced or restarted, it is pinged again before the next request
+        servers.erase(dev_addr);
+        return makeError(error_code.message());
+    }
+    return response.str();
+}
+
+ClientDaemon::~ClientDaemon()
+{
+    if (listen_fd >= 0)
+    {
+        ::close(listen_fd);
+        ::unlink(socket_path.c_str());
+    }
+    joinConnections(true);
+}
+
+bool ClientDaemon::addPort(const std::string& path, const sp::PortConfig& config)
+{
+    auto port = std::make_unique<PortService>(path, config);
+    if (port->start())
+    {
+        return false;
+    }
+    ports.push_back(std::move(port));
+    return true;
+}
+
+bool ClientDaemon::listen(const std::string& path)
+{
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0)
+    {
+        return false;
+    }
+    // socket left by the daemon which was killed
+    ::unlink(path.c_str());
+    // only the owner may connect, socket is never accessible with the process umask, not even until chmod
+    const mode_t mask = ::umask(S_IRWXG | S_IRWXO | S_IXUSR);
+    const bool bound = ::bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+    ::umask(mask);
+    if (!bound || (::chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0) || (::listen(listen_fd, SOMAXCONN) != 0))
+    {
+        ::close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    socket_path = path;
+    return true;
+}
+
+void ClientDaemon::run()
+{
+    pollfd listener{listen_fd, POLLIN, 0};
+    while (!stopping.load(std::memory_order_relaxed))
+    {
+        joinConnections(false);
+        // stop() is checked periodically, signal handler can not wake up the poll safely
+        if (::poll(&listener, 1, daemon_accept_period_ms) <= 0)
+        {
+            continue;
+        }
+        const int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            continue;
+        }
+        connections.emplace_back();
+        Connection& connection = connections.back();
+        connection.fd = fd;
+        connection.thread = std::thread(&ClientDaemon::serveConnection, this, std::ref(connection));
+    }
+    for (auto& connection : connections)
+    {
+        // blocked recv returns, request in progress is completed first
+        ::shutdown(connection.fd, SHUT_RDWR);
+    }
+    joinConnections(true);
+}
+
+void ClientDaemon::joinConnections(const bool all)
+{
+    for (auto connection = connections.begin(); connection != connections.end();)
+    {
+        if (all || connection->done.load(std::memory_order_acquire))
+        {
+            connection->thread.join();
+            ::close(connection->fd);
+            connection = connections.erase(connection);
+        }
+        else
+        {
+            ++connection;
+        }
+    }
+}
+
+void ClientDaemon::serveConnection(Connection& connection)
+{
+    std::string buffer;
+    char data[512];
+    bool open = true;
+    while (open)
+    {
+        const auto received = ::recv(connection.fd, data, sizeof(data), 0);
+        if ((received < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            break;
+        }
+        buffer.append(data, static_cast<size_t>(received));
+        size_t end = 0;
+        while (open && ((end = buffer.find('\n')) != std::string::npos))
+        {
+            std::string line = buffer.substr(0, end);
+            buffer.erase(0, end + 1);
+            if (!line.empty() && (line.back() == '\r'))
+            {
+                line.pop_back();
+            }
+            open = sendAll(connection.fd, dispatch(line) + "\n");
+        }
+        if (buffer.size() > daemon_max_line)
+        {
+            sendAll(connection.fd, makeError("line is too long") + "\n");
+            open = false;
+        }
+    }
+    connection.done.store(true, std::memory_order_release);
+}
+
+std::string ClientDaemon::dispatch(const std::string& line)
+{
+    std::istringstream stream(line);
+    std::vector<std::string> words;
+    std::string word;
+    while (stream >> word)
+    {
+        words.push_back(word);
+    }
+    if (words.empty())
+    {
+        return makeError("empty request");
+    }
+    if (words[0] == "ports")
+    {
+        std::string response = "ok";
+        for (const auto& port : ports)
+        {
+            response += " " + port->getPath();
+        }
+        return response;
+    }
+    if (words.size() < 2)
+    {
+        return makeError("port is missing");
+    }
+    PortService* port = findPort(words[1]);
+    if (port == nullptr)
+    {
+        return makeError("unknown port " + words[1]);
+    }
+    return port->execute(words[0], std::vector<std::string>(words.begin() + 2, words.end()));
+}
+
+PortService* ClientDaemon::findPort(const std::string& name)
+{
+    for (const auto& port : ports)
+    {
+        if (port->getPath() == name)
+        {
+            return port.get();
+        }
+    }
+    unsigned long index = 0;
+    if (parseNumber(name, ports.size(), index) && (index < ports.size()))
+    {
+        return ports[index].get();
+    }
+    return nullptr;
+}
+
+} // namespace sm
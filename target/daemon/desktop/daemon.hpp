@@ -0,0 +1,115 @@
+/**
+ * @file daemon.hpp
+ *
+ * @brief client daemon, serial ports stay open and servers stay prepared between requests of local processes
+ *
+ * @author
+ *
+ */
+
+#ifndef SM_DAEMON_H
+#define SM_DAEMON_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "sm_client.hpp"
+
+namespace sm
+{
+
+constexpr size_t daemon_max_line = 4096;
+constexpr int daemon_accept_period_ms = 200;
+
+// one line per request, one line per response:
+//   ports
+//   ping <port> <address>
+//   read <port> <address> <register> <quantity>
+//   write <port> <address> <register> <value> [value ...]
+//   read_file <port> <address> <file id> <size> <path>
+//   write_file <port> <address> <file id> <path>
+//   metrics <port> <path>
+//   forget <port> <address>
+// port is path of the serial port or its index in the ports list, numbers may be decimal or 0x hex,
+// response is "ok [values]" or "error <message>", paths are opened by the daemon.
+// Socket is created with mode 0600, only processes of the daemon user may send requests,
+// because every request drives the bus and file paths are opened with the daemon permissions.
+struct DaemonRequest
+{
+    std::string command;
+    std::vector<std::string> args;
+    std::promise<std::string> response;
+};
+
+// owns one serial port, requests of all connections are executed one by one by own thread
+class PortService
+{
+public:
+    PortService(std::string path, const sp::PortConfig& config);
+    ~PortService();
+    PortService(const PortService&) = delete;
+    PortService& operator=(const PortService&) = delete;
+    std::error_code start();
+    // blocks until the request is executed, every connection waits for its response before
+    // the next request is read, so FIFO order serves the connections round robin
+    std::string execute(const std::string& command, const std::vector<std::string>& args);
+    const std::string& getPath() const { return path; }
+
+private:
+    const std::string path;
+    const sp::PortConfig config;
+    ModbusClient client;
+    // servers pinged since the daemon start and their record size, dropped after failed exchange
+    std::map<std::uint8_t, std::uint8_t> servers;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<DaemonRequest*> queue; // protected by queue_mutex
+    bool stop = false;                // protected by queue_mutex
+    std::thread worker;
+    void workerThread();
+    std::string process(const std::string& command, const std::vector<std::string>& args);
+    std::error_code prepareServer(const std::uint8_t dev_addr, std::uint8_t& record_size);
+};
+
+class ClientDaemon
+{
+public:
+    ~ClientDaemon();
+    bool addPort(const std::string& path, const sp::PortConfig& config);
+    bool listen(const std::string& socket_path);
+    // accepts connections until stop() is called
+    void run();
+    // safe to call from signal handler
+    void stop() { stopping.store(true, std::memory_order_relaxed); }
+
+private:
+    struct Connection
+    {
+        int fd = -1;
+        std::thread thread;
+        std::atomic<bool> done{false};
+    };
+    std::vector<std::unique_ptr<PortService>> ports;
+    std::list<Connection> connections;
+    std::string socket_path;
+    int listen_fd = -1;
+    std::atomic<bool> stopping{false};
+    void serveConnection(Connection& connection);
+    std::string dispatch(const std::string& line);
+    PortService* findPort(const std::string& name);
+    void joinConnections(const bool all);
+};
+
+} // namespace sm
+
+#endif // SM_DAEMON_H
@@ -0,0 +1,66 @@
+/**
+ * @file main.cpp
+ *
+ * @brief client daemon, local processes send requests to the opened ports over UNIX socket
+ *
+ * @author
+ *
+ */
+
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include "daemon.hpp"
+
+namespace
+{
+
+sm::ClientDaemon* active_daemon = nullptr;
+
+void onSignal(int)
+{
+    if(active_daemon != nullptr)
+    {
+        active_daemon->stop();
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if(argc < 3)
+    {
+        std::printf("usage: sm_daemon <socket path> <port> [port ...]\n");
+        return 0;
+    }
+    sp::PortConfig config;
+    config.baudrate = sp::PortBaudRate::BD_57600;
+    config.timeout_ms = 2000;
+
+    sm::ClientDaemon daemon;
+    for(int i = 2; i < argc; ++i)
+    {
+        if(!daemon.addPort(argv[i], config))
+        {
+            std::printf("failed to open %s, exit...\n", argv[i]);
+            return 1;
+        }
+        std::printf("port %d: %s\n", i - 2, argv[i]);
+    }
+    if(!daemon.listen(argv[1]))
+    {
+        std::printf("failed to listen on %s, exit...\n", argv[1]);
+        return 1;
+    }
+    std::printf("listening on %s\n", argv[1]);
+
+    active_daemon = &daemon;
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    // client exits after the response is sent or when the daemon is stopped
+    std::signal(SIGPIPE, SIG_IGN);
+    daemon.run();
+    active_daemon = nullptr;
+    return 0;
+}
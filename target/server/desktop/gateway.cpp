@@ -0,0 +1,87 @@
+/**
+ * @file gateway.cpp
+ *
+ * @brief
+ *
+ * @author
+ *
+ */
+
+#include <iostream>
+#include "platform.hpp"
+#include "../../../core/server/inc/sm_gateway.hpp"
+
+constexpr std::uint8_t record_size = 208;
+constexpr size_t num_of_downstreams = 2;
+
+PlatformSupport platform_support;
+
+int main(int argc, char* argv[])
+{
+    if(argc < 4)
+    {
+        std::printf("usage: %s <upstream port> <address> <downstream port>[@first-last] [<downstream port>[@first-last]]\n", argv[0]);
+        return 0;
+    }
+    std::string path_to_port = argv[1];
+    std::uint8_t address;
+    try
+    {
+        auto number = std::stoi(argv[2]);
+        if( (number > modbus::max_rtu_address) || (number < modbus::min_rtu_address) )
+        {
+            std::cout <<"out of range address passed, exit...\n";
+            return 0;
+        }
+        address = static_cast<std::uint8_t>(number);
+    }
+    catch (std::invalid_argument const& ex)
+    {
+        std::cout <<"invalid argument passed, exit...\n";
+        return 0;
+    }
+
+    sp::PortConfig config;
+    config.baudrate = sp::PortBaudRate::BD_57600;
+    config.timeout_ms = 2000;
+
+    platform_support.setPath(path_to_port);
+    platform_support.setConfig(config);
+
+    sm::GatewayNode<DesktopCom,DesktopTimer,DesktopWaitPolicy,num_of_downstreams> gateway_node(address,record_size);
+
+    for(int i = 3; (i < argc) && (static_cast<size_t>(i - 3) < num_of_downstreams); ++i)
+    {
+        const size_t downstream = static_cast<size_t>(i - 3);
+        std::string arg = argv[i];
+        // without address range every address except own is routed to this downstream
+        int first = modbus::min_rtu_address;
+        int last = modbus::max_rtu_address;
+        const auto separator = arg.find('@');
+        if(separator != std::string::npos)
+        {
+            try
+            {
+                const std::string range = arg.substr(separator + 1);
+                const auto dash = range.find('-');
+                first = std::stoi(range.substr(0, dash));
+                last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+            }
+            catch (std::invalid_argument const& ex)
+            {
+                std::cout <<"invalid address range passed, exit...\n";
+                return 0;
+            }
+            arg.resize(separator);
+        }
+        if(!gateway_node.setRoute(static_cast<std::uint8_t>(first), static_cast<std::uint8_t>(last), downstream))
+        {
+            std::cout <<"out of range address passed, exit...\n";
+            return 0;
+        }
+        gateway_node.getDownstream(downstream).setPort(arg, config);
+    }
+
+    gateway_node.start();
+    gateway_node.loop();
+}
@@ -8,11 +8,16 @@
  */
 
 #include <cassert>
+#include <cerrno>
+#include <cstdlib>
 #include <iostream>
 #include "platform.hpp"
+#include "storage.hpp"
 
 
 constexpr std::uint8_t record_size = 208;
+constexpr std::uint32_t application_file_size = record_size * modbus::max_num_of_records;
+constexpr std::uint32_t metadata_file_size = 4096;
 
 PlatformSupport platform_support;
 
@@ -53,8 +58,52 @@ int main(int argc, char* argv[])
     platform_support.setPath(path_to_port);
     platform_support.setConfig(config);
 
+    // mapped files must outlive the server which writes to them
+    DesktopStorage storage;
     sm::DataNode<DesktopCom,DesktopTimer,DesktopWaitPolicy> data_node(address,record_size);
 
+    // optional storage directory and msync policy: record, batch <N> or complete
+    if(argc > 3)
+    {
+        std::string policy_str = (argc > 4) ? argv[4] : "complete";
+        std::uint32_t records = 1;
+        if(argc > 5)
+        {
+            char* end = nullptr;
+            errno = 0;
+            const unsigned long number = std::strtoul(argv[5], &end, 10);
+            if((argv[5][0] == '-') || (errno != 0) || (*end != '\0') || (end == argv[5]) || (number == 0) || (number > UINT32_MAX))
+            {
+                std::printf("usage: %s <port> <address> [storage dir] [record | batch <N> | complete], N > 0\n", argv[0]);
+                return 1;
+            }
+            records = static_cast<std::uint32_t>(number);
+        }
+        if(policy_str == "record")
+        {
+            storage.setSyncPolicy(SyncPolicy::per_record);
+        }
+        else if(policy_str == "batch")
+        {
+            storage.setSyncPolicy(SyncPolicy::per_n_records, records);
+        }
+        else if(policy_str == "complete")
+        {
+            storage.setSyncPolicy(SyncPolicy::on_complete);
+        }
+        else
+        {
+            std::printf("usage: %s <port> <address> [storage dir] [record | batch <N> | complete], N > 0\n", argv[0]);
+            return 1;
+        }
+        if(!storage.open(argv[3], application_file_size, metadata_file_size))
+        {
+            std::cout <<"failed to open storage, exit...\n";
+            return 0;
+        }
+        storage.attach(data_node.getServer().getResources());
+    }
+
     data_node.start();
     data_node.loop();
 }
@@ -8,69 +8,313 @@
  */
 
 #include "platform.hpp"
+#include <cerrno>
 #include <cstdio>
+#include <cstring>
+#include <fcntl.h>
 #include <iostream>
-#include <vector>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <termios.h>
+#include <unistd.h>
 
 std::string PlatformSupport::path;
 sp::PortConfig PlatformSupport::config;
 
-void DesktopTimer::platformStart()
+DesktopWaitPolicy::DesktopWaitPolicy() : event_fd(eventfd(0, EFD_CLOEXEC))
+{
+    if(event_fd < 0)
+    {
+        std::printf("eventfd creation failed !\n");
+    }
+}
+
+DesktopWaitPolicy::~DesktopWaitPolicy()
+{
+    if(event_fd >= 0)
+    {
+        close(event_fd);
+    }
+}
+
+void DesktopWaitPolicy::wait()
+{
+    std::uint64_t counter = 0;
+    // counter accumulates notifications, so events sent before wait() are not lost
+    if((event_fd < 0) || (read(event_fd, &counter, sizeof(counter)) != sizeof(counter)))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void DesktopWaitPolicy::notify()
+{
+    const std::uint64_t counter = 1;
+    if(event_fd >= 0)
+    {
+        [[maybe_unused]] auto result = write(event_fd, &counter, sizeof(counter));
+    }
+}
+
+DesktopTimerService& DesktopTimerService::instance()
+{
+    static DesktopTimerService service;
+    return service;
+}
+
+DesktopTimerService::DesktopTimerService() :
+    timer_fd(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)), wake_fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+{
+    if((timer_fd < 0) || (wake_fd < 0))
+    {
+        std::printf("timer service init error !\n");
+    }
+    service_thread = std::thread(&DesktopTimerService::serviceThread, this);
+}
+
+DesktopTimerService::~DesktopTimerService()
+{
+    const std::uint64_t counter = 1;
+    thread_stop.store(true, std::memory_order_relaxed);
+    [[maybe_unused]] auto result = write(wake_fd, &counter, sizeof(counter));
+    service_thread.join();
+    close(timer_fd);
+    close(wake_fd);
+}
+
+void DesktopTimerService::start(sm::TimerWheelEntry& entry, const std::uint32_t timeout_ms)
+{
+    std::lock_guard<std::mutex> lk(m);
+    if(wheel.empty())
+    {
+        arm(true);
+    }
+    wheel.start(entry, timeout_ms);
+}
+
+void DesktopTimerService::stop(sm::TimerWheelEntry& entry)
+{
+    std::lock_guard<std::mutex> lk(m);
+    wheel.stop(entry);
+}
+
+void DesktopTimerService::serviceThread()
+{
+    pollfd fds[2] = {{timer_fd, POLLIN, 0}, {wake_fd, POLLIN, 0}};
+    while(!thread_stop.load(std::memory_order_relaxed))
+    {
+        if(poll(fds, 2, -1) <= 0)
+        {
+            continue;
+        }
+        std::uint64_t ticks = 0;
+        if((fds[0].revents & POLLIN) && (read(timer_fd, &ticks, sizeof(ticks)) == sizeof(ticks)))
+        {
+            std::lock_guard<std::mutex> lk(m);
+            // expiration callbacks only set timer state, they are safe to call under the lock
+            wheel.advance(ticks);
+            if(wheel.empty())
+            {
+                arm(false);
+            }
+        }
+    }
+}
+
+void DesktopTimerService::arm(const bool enable)
+{
+    itimerspec spec{};
+    if(enable)
+    {
+        spec.it_interval.tv_nsec = 1000000;
+        spec.it_value.tv_nsec = 1000000;
+    }
+    timerfd_settime(timer_fd, 0, &spec, nullptr);
+}
+
+DesktopTimer::DesktopTimer()
 {
+    entry.callback = &DesktopTimer::onExpired;
+    entry.context = this;
+}
 
+void DesktopTimer::platformStart()
+{
+    DesktopTimerService::instance().start(entry, getTimeout());
 }
 
 void DesktopTimer::platformStop()
 {
+    DesktopTimerService::instance().stop(entry);
+}
+
+DesktopCom::DesktopCom() : wake_fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+{
+    server_thread = std::thread(&DesktopCom::serverThread, this);
+}
 
+DesktopCom::~DesktopCom()
+{
+    {
+        std::lock_guard<std::mutex> lk(m);
+        thread_stop.store(true, std::memory_order_relaxed);
+    }
+    blocker.notify_one();
+    wakeUp();
+    server_thread.join();
+    if(port_fd >= 0)
+    {
+        close(port_fd);
+    }
+    if(wake_fd >= 0)
+    {
+        close(wake_fd);
+    }
 }
 
 void DesktopCom::serverThread()
 {
-    std::vector<std::uint8_t> data;
-    
     while (!thread_stop.load(std::memory_order_relaxed))
     {
-        std::unique_lock<std::mutex>lk(m);
-        blocker.wait(lk);
+        BufferSupport request;
+        std::uint32_t request_generation = 0;
+        {
+            std::unique_lock<std::mutex> lk(m);
+            blocker.wait(lk, [this] { return request_pending || thread_stop.load(std::memory_order_relaxed); });
+            if(thread_stop.load(std::memory_order_relaxed))
+            {
+                break;
+            }
+            request_pending = false;
+            request = buffer_support;
+            request_generation = generation.load(std::memory_order_acquire);
+        }
+        // data is read directly into the node buffer
         size_t bytes_read = 0;
-        while(bytes_read != buffer_support.buffer_size)
+        pollfd fds[2] = {{port_fd, POLLIN, 0}, {wake_fd, POLLIN, 0}};
+        while(bytes_read != request.buffer_size)
         {
-            bytes_read = serial_port.readBinary(data, buffer_support.buffer_size);
-            if(bytes_read != buffer_support.buffer_size)
+            if(poll(fds, 2, -1) < 0)
+            {
+                if(errno == EINTR)
+                {
+                    continue;
+                }
+                break;
+            }
+            if(fds[1].revents & POLLIN)
+            {
+                std::uint64_t counter = 0;
+                [[maybe_unused]] auto result = read(wake_fd, &counter, sizeof(counter));
+            }
+            if(thread_stop.load(std::memory_order_relaxed) || (generation.load(std::memory_order_acquire) != request_generation))
+            {
+                break;
+            }
+            if(fds[0].revents & POLLIN)
+            {
+                ssize_t result = read(port_fd, request.buffer_ptr + bytes_read, request.buffer_size - bytes_read);
+                if(result > 0)
+                {
+                    bytes_read += static_cast<size_t>(result);
+                    if(bytes_read != request.buffer_size)
+                    {
+                        // frame reception in progress, node will start receive timeout
+                        setBusy();
+                    }
+                }
+            }
+            else if(fds[0].revents & (POLLHUP | POLLERR))
             {
-                std::printf("port reading timeout !\n");
+                // other side of the link is closed, do not spin on it
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
             }
         }
-        std::copy(data.begin(), data.end(), buffer_support.buffer_ptr);
-        std::printf("port reading finished.\n");
+        if((bytes_read == request.buffer_size) && (generation.load(std::memory_order_acquire) == request_generation))
+        {
+            rx_bytes.fetch_add(bytes_read, std::memory_order_relaxed);
+            rx_frames.fetch_add(1, std::memory_order_relaxed);
+            // wakes up node waiting in DesktopWaitPolicy
+            setReady();
+        }
     }
 }
 
 void DesktopCom::platformReadData(std::uint8_t data[], const size_t amount)
 {
-    buffer_support.buffer_ptr = data;
-    buffer_support.buffer_size = amount;
+    {
+        std::lock_guard<std::mutex> lk(m);
+        buffer_support.buffer_ptr = data;
+        buffer_support.buffer_size = amount;
+        generation.fetch_add(1, std::memory_order_acq_rel);
+        request_pending = true;
+    }
     // start reading in separated thread
     blocker.notify_one();
+    wakeUp();
 }
 
 void DesktopCom::platformSendData(std::uint8_t data[], const size_t amount)
 {
-    std::vector<std::uint8_t> tmp(data,data + amount);
-    serial_port.writeBinary(tmp);
+    // data is written directly from the node buffer
+    size_t bytes_written = 0;
+    while(bytes_written != amount)
+    {
+        ssize_t result = write(port_fd, data + bytes_written, amount - bytes_written);
+        if(result > 0)
+        {
+            bytes_written += static_cast<size_t>(result);
+        }
+        else if((result < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+        {
+            pollfd fd = {port_fd, POLLOUT, 0};
+            poll(&fd, 1, -1);
+        }
+        else
+        {
+            std::printf("port writing error !\n");
+            return;
+        }
+    }
+    tx_bytes.fetch_add(bytes_written, std::memory_order_relaxed);
+    tx_frames.fetch_add(1, std::memory_order_relaxed);
 }
 
 void DesktopCom::platformFlush()
 {
-    serial_port.flushPort();
+    generation.fetch_add(1, std::memory_order_acq_rel);
+    wakeUp();
+    tcflush(port_fd, TCIOFLUSH);
+}
+
+ComCounters DesktopCom::getCounters() const
+{
+    ComCounters counters;
+    counters.rx_bytes = rx_bytes.load(std::memory_order_relaxed);
+    counters.tx_bytes = tx_bytes.load(std::memory_order_relaxed);
+    counters.rx_frames = rx_frames.load(std::memory_order_relaxed);
+    counters.tx_frames = tx_frames.load(std::memory_order_relaxed);
+    return counters;
+}
+
+void DesktopCom::wakeUp()
+{
+    const std::uint64_t counter = 1;
+    if(wake_fd >= 0)
+    {
+        [[maybe_unused]] auto result = write(wake_fd, &counter, sizeof(counter));
+    }
 }
 
 bool DesktopCom::platformInit()
 {
     std::printf("platform init started...\n\n");
-    std::string path = PlatformSupport::getPath();
-    sp::PortConfig config = PlatformSupport::getConfig();
+    if(path.empty())
+    {
+        path = PlatformSupport::getPath();
+        config = PlatformSupport::getConfig();
+    }
     auto error_code = serial_port.open(path);
     if(error_code)
     {
@@ -85,6 +329,13 @@ bool DesktopCom::platformInit()
         std::cout<<"error: "<<error_code.message()<<"\n";
         return false;
     }
+    port_fd = open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if((port_fd < 0) || (wake_fd < 0))
+    {
+        std::printf("platform init error.\n");
+        std::cout<<"error: "<<std::strerror(errno)<<"\n";
+        return false;
+    }
     std::printf("platform configured.\n\n");
     return true;
-}
\ No newline at end of file
+}
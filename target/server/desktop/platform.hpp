@@ -16,6 +16,7 @@
 #include <thread>
 #include "../../../core/server/inc/sm_com.hpp"
 #include "../../../core/server/inc/sm_timer.hpp"
+#include "../../../core/server/inc/sm_timer_wheel.hpp"
 #include "../../../core/server/inc/sm_node.hpp"
 #include "../../../core/external/simple-serial-port/inc/serial_port.hpp"
 
@@ -49,44 +50,103 @@ private:
     static sp::PortConfig config;
 };
 
-struct DesktopWaitPolicy
+// blocks on eventfd until Com or Timer reports new state, no periodic wakeups
+class DesktopWaitPolicy
 {
-    static void wait()
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
-    }
+public:
+    DesktopWaitPolicy();
+    ~DesktopWaitPolicy();
+    DesktopWaitPolicy(const DesktopWaitPolicy&) = delete;
+    DesktopWaitPolicy& operator=(const DesktopWaitPolicy&) = delete;
+    void wait();
+    void notify();
+
+private:
+    int event_fd = -1;
+};
+
+// single thread with timerfd drives timer wheel for all DesktopTimer instances, timerfd is armed only while wheel has entries
+class DesktopTimerService
+{
+public:
+    static DesktopTimerService& instance();
+    ~DesktopTimerService();
+    DesktopTimerService(const DesktopTimerService&) = delete;
+    DesktopTimerService& operator=(const DesktopTimerService&) = delete;
+    void start(sm::TimerWheelEntry& entry, const std::uint32_t timeout_ms);
+    void stop(sm::TimerWheelEntry& entry);
+
+private:
+    DesktopTimerService();
+    std::mutex m;
+    sm::TimerWheel<> wheel; // 1 ms per tick
+    int timer_fd = -1;
+    int wake_fd = -1;
+    std::atomic<bool> thread_stop{false};
+    std::thread service_thread;
+    void serviceThread();
+    void arm(const bool enable);
 };
 
 class DesktopTimer : public sm::Timer<DesktopTimer>
 {
 public:
+    DesktopTimer();
+    ~DesktopTimer() { platformStop(); }
     void platformStart();
     void platformStop();
+
+private:
+    sm::TimerWheelEntry entry;
+    static void onExpired(void* context) { static_cast<DesktopTimer*>(context)->setDone(); }
+};
+
+struct ComCounters
+{
+    std::uint64_t rx_bytes = 0;
+    std::uint64_t tx_bytes = 0;
+    std::uint64_t rx_frames = 0;
+    std::uint64_t tx_frames = 0;
 };
 
 class DesktopCom : public sm::Com<DesktopCom>
 {
 public:
-    DesktopCom() : server_thread(&DesktopCom::serverThread, this) {}
-    ~DesktopCom()
-    {
-        blocker.notify_one();
-        thread_stop.store(true, std::memory_order_relaxed);
-        server_thread.join();
-    }
+    DesktopCom();
+    ~DesktopCom();
     bool platformInit();
     void platformSendData(std::uint8_t data[], const size_t amount);
     void platformReadData(std::uint8_t data[], const size_t amount);
     void platformFlush();
+    ComCounters getCounters() const;
+    // port used instead of PlatformSupport settings, for nodes with several ports
+    void setPort(const std::string& new_path, const sp::PortConfig& new_config)
+    {
+        path = new_path;
+        config = new_config;
+    }
 
 private:
     std::mutex m;
     std::condition_variable blocker;
     std::thread server_thread;
     std::atomic<bool> thread_stop{false};
+    // changed on every new read request or flush, aborts read in progress
+    std::atomic<std::uint32_t> generation{0};
+    bool request_pending = false;
     sp::SerialPort serial_port;
+    // port is configured by serial_port, data goes through own descriptor directly from/to node buffer
+    int port_fd = -1;
+    int wake_fd = -1;
+    std::string path;
+    sp::PortConfig config;
     BufferSupport buffer_support;
+    std::atomic<std::uint64_t> rx_bytes{0};
+    std::atomic<std::uint64_t> tx_bytes{0};
+    std::atomic<std::uint64_t> rx_frames{0};
+    std::atomic<std::uint64_t> tx_frames{0};
     void serverThread();
+    void wakeUp();
 };
 
 #endif // PLATFORM_HPP
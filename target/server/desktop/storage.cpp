@@ -0,0 +1,182 @@
+/**
+ * @file storage.cpp
+ *
+ * @brief memory-mapped file storage for desktop server
+ *
+ * @author
+ *
+ */
+
+#include "storage.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../../../core/common/sm_modbus.hpp"
+
+bool MappedFile::open(const std::string& path, const std::uint32_t size)
+{
+    close();
+    if (size == 0)
+    {
+        return false;
+    }
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    if ((fstat(fd, &info) != 0) || ((static_cast<std::uint32_t>(info.st_size) < size) && (ftruncate(fd, size) != 0)))
+    {
+        close();
+        return false;
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+    data = static_cast<std::uint8_t*>(mapping);
+    this->size = size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data != nullptr)
+    {
+        msync(data, size, MS_SYNC);
+        munmap(data, size);
+        data = nullptr;
+        size = 0;
+    }
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void MappedFile::sync(const std::uint32_t offset, const std::uint32_t length)
+{
+    if ((data == nullptr) || (length == 0) || (offset >= size))
+    {
+        return;
+    }
+    // msync requires page aligned start address
+    static const std::uint32_t page_size = static_cast<std::uint32_t>(sysconf(_SC_PAGESIZE));
+    const std::uint32_t aligned_offset = offset - (offset % page_size);
+    const std::uint32_t end = std::min(offset + length, size);
+    msync(data + aligned_offset, end - aligned_offset, MS_SYNC);
+}
+
+bool DesktopStorage::open(const std::string& dir, const std::uint32_t app_size, const std::uint32_t metadata_size)
+{
+    const size_t app_index = sm::FileDefinitions::application - modbus::files_offset;
+    const size_t metadata_index = sm::FileDefinitions::metadata - modbus::files_offset;
+    if (!files[app_index].open(dir + "/application.bin", app_size))
+    {
+        std::printf("failed to map application file.\n");
+        return false;
+    }
+    if (!files[metadata_index].open(dir + "/metadata.bin", metadata_size))
+    {
+        std::printf("failed to map metadata file.\n");
+        files[app_index].close();
+        return false;
+    }
+    dirty.fill(DirtyRange());
+    return true;
+}
+
+void DesktopStorage::close()
+{
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        flush(i);
+        files[i].close();
+    }
+}
+
+void DesktopStorage::attach(sm::ServerResources& resources)
+{
+    const sm::Attributes read_write{true, true, false};
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        if (files[i].isOpen())
+        {
+            sm::FileInfo info(read_write, sm::FileData{files[i].getData(), files[i].getSize()});
+            info.callback = &DesktopStorage::onRecordWritten;
+            info.context = this;
+            resources.setFile(static_cast<std::uint16_t>(i + modbus::files_offset), info);
+        }
+    }
+}
+
+void DesktopStorage::setSyncPolicy(const SyncPolicy new_policy, const std::uint32_t n)
+{
+    policy = new_policy;
+    records_per_sync = (n == 0) ? 1 : n;
+}
+
+void DesktopStorage::onRecordWritten(const sm::FileInfo* info, const sm::FileControl* control)
+{
+    static_cast<DesktopStorage*>(info->context)->recordWritten(info, control);
+}
+
+void DesktopStorage::recordWritten(const sm::FileInfo* info, const sm::FileControl* control)
+{
+    const size_t index = control->index;
+    if ((index >= files.size()) || (info->data.p_data != files[index].getData()))
+    {
+        return;
+    }
+    const std::uint32_t offset = static_cast<std::uint32_t>(control->p_record - info->data.p_data);
+    DirtyRange& range = dirty[index];
+    if (range.records == 0)
+    {
+        range.begin = offset;
+        range.end = offset + control->length;
+    }
+    else
+    {
+        range.begin = std::min(range.begin, offset);
+        range.end = std::max(range.end, offset + control->length);
+    }
+    ++range.records;
+    switch (policy)
+    {
+        case SyncPolicy::per_record:
+            flush(index);
+            break;
+
+        case SyncPolicy::per_n_records:
+            if ((range.records >= records_per_sync) || control->is_last)
+            {
+                flush(index);
+            }
+            break;
+
+        case SyncPolicy::on_complete:
+            if (control->is_last)
+            {
+                flush(index);
+            }
+            break;
+    }
+}
+
+void DesktopStorage::flush(const size_t index)
+{
+    DirtyRange& range = dirty[index];
+    if (range.records != 0)
+    {
+        files[index].sync(range.begin, range.end - range.begin);
+        ++sync_counter;
+        range = DirtyRange();
+    }
+}
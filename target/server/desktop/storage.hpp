@@ -0,0 +1,105 @@
+/**
+ * @file storage.hpp
+ *
+ * @brief memory-mapped file storage for desktop server
+ *
+ * @author
+ *
+ */
+
+#ifndef STORAGE_HPP
+#define STORAGE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "../../../core/common/sm_common.hpp"
+#include "../../../core/server/inc/sm_resources.hpp"
+
+enum class SyncPolicy
+{
+    per_record,    // msync every written record
+    per_n_records, // msync dirty range after every N records
+    on_complete    // msync dirty range after the last record of the transfer
+};
+
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+    /**
+     * @brief map file into memory, file will be created or extended to the required size
+     *
+     * @param path path to file
+     * @param size required file size in bytes
+     * @return true in case of success
+     */
+    bool open(const std::string& path, const std::uint32_t size);
+    void close();
+    /**
+     * @brief write back range of the mapping to the drive
+     *
+     * @param offset offset in bytes from the mapping start
+     * @param length length in bytes
+     */
+    void sync(const std::uint32_t offset, const std::uint32_t length);
+    std::uint8_t* getData() const { return data; }
+    std::uint32_t getSize() const { return size; }
+    bool isOpen() const { return data != nullptr; }
+
+private:
+    std::uint8_t* data = nullptr;
+    std::uint32_t size = 0;
+    int fd = -1;
+};
+
+// one instance per server, mapped files are released when the instance is destroyed
+class DesktopStorage
+{
+public:
+    DesktopStorage() = default;
+    DesktopStorage(const DesktopStorage&) = delete;
+    DesktopStorage& operator=(const DesktopStorage&) = delete;
+    ~DesktopStorage() { close(); }
+    /**
+     * @brief map application and metadata files from the selected directory
+     *
+     * @param dir directory with file images
+     * @param app_size size of the application file in bytes
+     * @param metadata_size size of the metadata file in bytes
+     * @return true in case of success
+     */
+    bool open(const std::string& dir, const std::uint32_t app_size, const std::uint32_t metadata_size);
+    void close();
+    /**
+     * @brief register mapped files in server resources, the storage must outlive the server
+     *
+     * @param resources server resources
+     */
+    void attach(sm::ServerResources& resources);
+    void setSyncPolicy(const SyncPolicy new_policy, const std::uint32_t n = 1);
+    SyncPolicy getSyncPolicy() const { return policy; }
+    std::uint32_t getSyncCounter() const { return sync_counter; }
+
+private:
+    struct DirtyRange
+    {
+        std::uint32_t begin = 0;
+        std::uint32_t end = 0;
+        std::uint32_t records = 0;
+    };
+    std::array<MappedFile, sm::FileDefinitions::getSize()> files;
+    std::array<DirtyRange, sm::FileDefinitions::getSize()> dirty;
+    SyncPolicy policy = SyncPolicy::on_complete;
+    std::uint32_t records_per_sync = 1;
+    std::uint32_t sync_counter = 0;
+    static void onRecordWritten(const sm::FileInfo* info, const sm::FileControl* control);
+    void recordWritten(const sm::FileInfo* info, const sm::FileControl* control);
+    void flush(const size_t index);
+};
+
+#endif // STORAGE_HPP
@@ -0,0 +1,271 @@
+/**
+ * @file bus.cpp
+ *
+ * @brief RS-485 bus timing model and link simulator with error injection
+ *
+ * @author
+ *
+ */
+
+#include "bus.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace
+{
+// pty delivers frame written by one call in one piece, short gap closes the frame
+constexpr std::chrono::microseconds frame_idle_gap{200};
+// Modbus over serial line: fixed inter-frame delay above 19200 bps
+constexpr std::uint32_t fixed_silence_baudrate = 19200;
+constexpr std::chrono::microseconds fixed_silence{1750};
+// write file request and response: address, function, byte counter, reference, file, record, length, crc
+constexpr size_t write_file_overhead = 12;
+
+bool setRaw(const int fd)
+{
+    termios tty;
+    if (tcgetattr(fd, &tty) != 0)
+    {
+        return false;
+    }
+    cfmakeraw(&tty);
+    return tcsetattr(fd, TCSANOW, &tty) == 0;
+}
+} // namespace
+
+std::chrono::nanoseconds BusTiming::getCharTime() const
+{
+    const std::uint64_t baudrate = (config.baudrate == 0) ? 1 : config.baudrate;
+    return std::chrono::nanoseconds((config.bits_per_char * std::uint64_t(1000000000)) / baudrate);
+}
+
+std::chrono::nanoseconds BusTiming::getSilence() const
+{
+    if (config.baudrate > fixed_silence_baudrate)
+    {
+        return fixed_silence;
+    }
+    return (getCharTime() * 7) / 2;
+}
+
+TransferEstimate estimateFileWrite(const BusConfig& config, const size_t image_size, const std::uint8_t record_size,
+                                   const std::chrono::milliseconds response_timeout)
+{
+    TransferEstimate estimate;
+    if ((record_size == 0) || (image_size == 0))
+    {
+        return estimate;
+    }
+    const BusTiming timing(config);
+    estimate.num_of_records = static_cast<std::uint32_t>((image_size + record_size - 1) / record_size);
+    const auto frame_time = timing.getFrameTime(write_file_overhead + record_size);
+    estimate.exchange_time = (frame_time * 2) + config.turnaround + (timing.getSilence() * 2);
+    estimate.total_time = estimate.exchange_time * estimate.num_of_records;
+
+    const double frame_success = (1.0 - config.crc_error_rate) * (1.0 - config.drop_byte_rate) * (1.0 - config.timeout_rate);
+    const double exchange_success = frame_success * frame_success;
+    estimate.exchange_failure_rate = 1.0 - exchange_success;
+    estimate.success_without_retries = std::pow(exchange_success, estimate.num_of_records);
+    if (exchange_success > 0.0)
+    {
+        // failed exchange costs the request and full client timeout
+        const double failure_cost = std::chrono::duration<double>(frame_time + response_timeout).count();
+        const double exchange_cost = std::chrono::duration<double>(estimate.exchange_time).count();
+        const double per_record = exchange_cost + ((estimate.exchange_failure_rate / exchange_success) * failure_cost);
+        estimate.time_with_retries = std::chrono::nanoseconds(static_cast<std::int64_t>(per_record * estimate.num_of_records * 1e9));
+    }
+    return estimate;
+}
+
+BusSimulator::BusSimulator(const BusConfig& config) :
+    config(config), timing(config), generator(config.seed), timer_fd(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)),
+    wake_fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+{
+}
+
+BusSimulator::~BusSimulator()
+{
+    for (auto fd : {fds[client_side], fds[server_side], client_slave_fd, timer_fd, wake_fd})
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+}
+
+bool BusSimulator::open(const std::string& server_path)
+{
+    fds[client_side] = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if ((fds[client_side] < 0) || (grantpt(fds[client_side]) != 0) || (unlockpt(fds[client_side]) != 0))
+    {
+        return false;
+    }
+    client_path = ptsname(fds[client_side]);
+    // slave stays open, so the terminal survives client reconnects
+    client_slave_fd = ::open(client_path.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+    fds[server_side] = ::open(server_path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if ((client_slave_fd < 0) || (fds[server_side] < 0))
+    {
+        return false;
+    }
+    return setRaw(client_slave_fd) && setRaw(fds[server_side]);
+}
+
+void BusSimulator::run()
+{
+    pollfd poll_fds[4] = {{fds[client_side], POLLIN, 0}, {fds[server_side], POLLIN, 0}, {timer_fd, POLLIN, 0}, {wake_fd, POLLIN, 0}};
+    while (!loop_stop.load(std::memory_order_relaxed))
+    {
+        if (poll(poll_fds, 4, -1) < 0)
+        {
+            continue;
+        }
+        if (poll_fds[0].revents & POLLIN)
+        {
+            receive(client_side);
+        }
+        if (poll_fds[1].revents & POLLIN)
+        {
+            receive(server_side);
+        }
+        if (poll_fds[2].revents & POLLIN)
+        {
+            std::uint64_t expirations = 0;
+            [[maybe_unused]] auto result = read(timer_fd, &expirations, sizeof(expirations));
+        }
+        if (poll_fds[3].revents & POLLIN)
+        {
+            std::uint64_t counter = 0;
+            [[maybe_unused]] auto result = read(wake_fd, &counter, sizeof(counter));
+        }
+        const auto now = BusClock::now();
+        for (auto side : {client_side, server_side})
+        {
+            if (!incoming[side].data.empty() && ((now - incoming[side].last_rx) >= frame_idle_gap))
+            {
+                closeFrame(side);
+            }
+        }
+        deliver(now);
+        arm(now);
+    }
+}
+
+void BusSimulator::stop()
+{
+    const std::uint64_t counter = 1;
+    loop_stop.store(true, std::memory_order_relaxed);
+    [[maybe_unused]] auto result = write(wake_fd, &counter, sizeof(counter));
+}
+
+void BusSimulator::receive(const Side from)
+{
+    std::array<std::uint8_t, 256> chunk;
+    ssize_t result = read(fds[from], chunk.data(), chunk.size());
+    if (result <= 0)
+    {
+        return;
+    }
+    Frame& frame = incoming[from];
+    const auto now = BusClock::now();
+    if (frame.data.empty())
+    {
+        frame.first_byte = now;
+    }
+    frame.last_rx = now;
+    frame.data.insert(frame.data.end(), chunk.begin(), chunk.begin() + result);
+}
+
+void BusSimulator::closeFrame(const Side from)
+{
+    Frame& frame = incoming[from];
+    // transmission starts when the line is free, response also waits for the turnaround
+    auto start = std::max(frame.first_byte, bus_free);
+    if (from == server_side)
+    {
+        start = std::max(start, request_end + config.turnaround);
+    }
+    const auto end = start + timing.getFrameTime(frame.data.size());
+    bus_free = end + timing.getSilence();
+    if (from == client_side)
+    {
+        request_end = end;
+    }
+    counters.frames[from] += 1;
+    counters.bytes[from] += frame.data.size();
+    counters.busy_time += end - start;
+
+    bool lost = false;
+    injectErrors(frame.data, lost);
+    if (!lost)
+    {
+        deliveries.push_back(Delivery{end, (from == client_side) ? server_side : client_side, std::move(frame.data)});
+    }
+    frame.data.clear();
+}
+
+void BusSimulator::injectErrors(std::vector<std::uint8_t>& data, bool& lost)
+{
+    if (probability(generator) < config.timeout_rate)
+    {
+        ++counters.lost_frames;
+        lost = true;
+        return;
+    }
+    if (!data.empty() && (probability(generator) < config.drop_byte_rate))
+    {
+        data.erase(data.begin() + (generator() % data.size()));
+        ++counters.dropped_bytes;
+    }
+    if (!data.empty() && (probability(generator) < config.crc_error_rate))
+    {
+        data[generator() % data.size()] ^= static_cast<std::uint8_t>(1U << (generator() % 8));
+        ++counters.crc_errors;
+    }
+}
+
+void BusSimulator::deliver(const BusClock::time_point now)
+{
+    while (!deliveries.empty() && (deliveries.front().due <= now))
+    {
+        const Delivery& delivery = deliveries.front();
+        [[maybe_unused]] auto result = write(fds[delivery.to], delivery.data.data(), delivery.data.size());
+        deliveries.pop_front();
+    }
+}
+
+void BusSimulator::arm(const BusClock::time_point now)
+{
+    // next event is either frame close or delivery, whichever comes first
+    auto next = BusClock::time_point::max();
+    for (const auto& frame : incoming)
+    {
+        if (!frame.data.empty())
+        {
+            next = std::min(next, frame.last_rx + frame_idle_gap);
+        }
+    }
+    if (!deliveries.empty())
+    {
+        next = std::min(next, deliveries.front().due);
+    }
+    itimerspec spec{};
+    if (next != BusClock::time_point::max())
+    {
+        auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(next - now).count();
+        if (delay <= 0)
+        {
+            delay = 1;
+        }
+        spec.it_value.tv_sec = delay / 1000000000;
+        spec.it_value.tv_nsec = delay % 1000000000;
+    }
+    timerfd_settime(timer_fd, 0, &spec, nullptr);
+}
@@ -0,0 +1,141 @@
+/**
+ * @file bus.hpp
+ *
+ * @brief RS-485 bus timing model and link simulator with error injection
+ *
+ * @author
+ *
+ */
+
+#ifndef BUS_HPP
+#define BUS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+using BusClock = std::chrono::steady_clock;
+
+struct BusConfig
+{
+    std::uint32_t baudrate = 57600;          // line speed in bits per second
+    std::uint8_t bits_per_char = 11;         // start + 8 data + parity + stop
+    std::chrono::microseconds turnaround{0}; // delay between request end and response start
+    double crc_error_rate = 0.0;             // probability of corrupted bit in frame
+    double drop_byte_rate = 0.0;             // probability of lost byte in frame
+    double timeout_rate = 0.0;               // probability of lost frame
+    std::uint32_t seed = 1;
+};
+
+struct BusCounters
+{
+    std::uint64_t frames[2] = {0, 0}; // requests, responses
+    std::uint64_t bytes[2] = {0, 0};
+    std::uint64_t crc_errors = 0;
+    std::uint64_t dropped_bytes = 0;
+    std::uint64_t lost_frames = 0;
+    std::chrono::nanoseconds busy_time{0};
+};
+
+// timing of the serial line, silence interval follows Modbus over serial line spec
+class BusTiming
+{
+public:
+    BusTiming(const BusConfig& config) : config(config) {}
+    std::chrono::nanoseconds getCharTime() const;
+    std::chrono::nanoseconds getFrameTime(const size_t bytes) const { return getCharTime() * bytes; }
+    std::chrono::nanoseconds getSilence() const;
+
+private:
+    BusConfig config;
+};
+
+struct TransferEstimate
+{
+    std::uint32_t num_of_records = 0;
+    std::chrono::nanoseconds exchange_time{0};   // one record request and response without errors
+    std::chrono::nanoseconds total_time{0};      // whole image without errors
+    double exchange_failure_rate = 0.0;          // probability that one exchange fails
+    double success_without_retries = 0.0;        // probability to complete image without any failed exchange
+    std::chrono::nanoseconds time_with_retries{0}; // expected time if every failed record is repeated
+};
+
+/**
+ * @brief estimate file write duration with the bus model
+ *
+ * @param config bus configuration
+ * @param image_size image size in bytes
+ * @param record_size record size in bytes
+ * @param response_timeout client response timeout, spent on every failed exchange
+ * @return TransferEstimate
+ */
+TransferEstimate estimateFileWrite(const BusConfig& config, const size_t image_size, const std::uint8_t record_size,
+                                   const std::chrono::milliseconds response_timeout);
+
+class BusSimulator
+{
+public:
+    BusSimulator(const BusConfig& config);
+    ~BusSimulator();
+    BusSimulator(const BusSimulator&) = delete;
+    BusSimulator& operator=(const BusSimulator&) = delete;
+    /**
+     * @brief create client side pseudo terminal and open server side port
+     *
+     * @param server_path path to the server port (device farm or server pty)
+     * @return true in case of success
+     */
+    bool open(const std::string& server_path);
+    std::string getClientPath() const { return client_path; }
+    void run();
+    void stop();
+    BusCounters getCounters() const { return counters; }
+
+private:
+    enum Side
+    {
+        client_side = 0,
+        server_side = 1
+    };
+    struct Frame
+    {
+        BusClock::time_point first_byte;
+        BusClock::time_point last_rx;
+        std::vector<std::uint8_t> data;
+    };
+    struct Delivery
+    {
+        BusClock::time_point due;
+        Side to;
+        std::vector<std::uint8_t> data;
+    };
+    BusConfig config;
+    BusTiming timing;
+    std::mt19937 generator;
+    std::uniform_real_distribution<double> probability{0.0, 1.0};
+    std::string client_path;
+    std::array<int, 2> fds{-1, -1};
+    int client_slave_fd = -1;
+    int timer_fd = -1;
+    int wake_fd = -1;
+    std::atomic<bool> loop_stop{false};
+    std::array<Frame, 2> incoming;
+    std::deque<Delivery> deliveries; // ordered by due time, bus is half duplex
+    BusClock::time_point bus_free;
+    BusClock::time_point request_end;
+    BusCounters counters;
+
+    void receive(const Side from);
+    void closeFrame(const Side from);
+    void injectErrors(std::vector<std::uint8_t>& data, bool& lost);
+    void deliver(const BusClock::time_point now);
+    void arm(const BusClock::time_point now);
+};
+
+#endif // BUS_HPP
@@ -0,0 +1,131 @@
+/**
+ * @file main.cpp
+ *
+ * @brief RS-485 bus simulator between client and server pseudo terminals
+ *
+ * @author
+ *
+ */
+
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include "bus.hpp"
+
+namespace
+{
+
+constexpr std::uint8_t record_sizes[] = {64, 128, 208, 240};
+constexpr std::chrono::milliseconds response_timeout{100};
+
+BusSimulator* active_bus = nullptr;
+
+void onSignal(int)
+{
+    if(active_bus != nullptr)
+    {
+        active_bus->stop();
+    }
+}
+
+void printUsage()
+{
+    std::printf("usage: sm_bus_sim <server port> <baudrate> [turnaround us] [crc error rate] [drop byte rate] [timeout rate]\n");
+    std::printf("       sm_bus_sim -e <image size> <baudrate> [turnaround us] [crc error rate] [drop byte rate] [timeout rate]\n");
+}
+
+void readConfig(BusConfig& config, int argc, char* argv[], const int first)
+{
+    config.baudrate = std::stoul(argv[first]);
+    config.turnaround = std::chrono::microseconds((argc > first + 1) ? std::stoul(argv[first + 1]) : 0);
+    config.crc_error_rate = (argc > first + 2) ? std::stod(argv[first + 2]) : 0.0;
+    config.drop_byte_rate = (argc > first + 3) ? std::stod(argv[first + 3]) : 0.0;
+    config.timeout_rate = (argc > first + 4) ? std::stod(argv[first + 4]) : 0.0;
+}
+
+void printEstimate(const BusConfig& config, const size_t image_size)
+{
+    std::printf("image %zu bytes, %u bps, response timeout %lld ms\n", image_size, config.baudrate,
+                static_cast<long long>(response_timeout.count()));
+    std::printf("record  records  exchange us  total s  failure rate  no retry success  with retries s\n");
+    for(auto record_size : record_sizes)
+    {
+        const TransferEstimate estimate = estimateFileWrite(config, image_size, record_size, response_timeout);
+        std::printf("%6u  %7u  %11.1f  %7.2f  %12.6f  %16.4f  %14.2f\n", record_size, estimate.num_of_records,
+                    std::chrono::duration<double, std::micro>(estimate.exchange_time).count(),
+                    std::chrono::duration<double>(estimate.total_time).count(), estimate.exchange_failure_rate,
+                    estimate.success_without_retries, std::chrono::duration<double>(estimate.time_with_retries).count());
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if(argc < 3)
+    {
+        printUsage();
+        return 0;
+    }
+    BusConfig config;
+    const bool estimate = (std::string(argv[1]) == "-e");
+    size_t image_size = 0;
+    try
+    {
+        if(estimate)
+        {
+            if(argc < 4)
+            {
+                printUsage();
+                return 0;
+            }
+            image_size = std::stoul(argv[2]);
+            readConfig(config, argc, argv, 3);
+        }
+        else
+        {
+            readConfig(config, argc, argv, 2);
+        }
+    }
+    catch (std::exception const& ex)
+    {
+        std::cout <<"invalid argument passed, exit...\n";
+        return 0;
+    }
+    if(config.baudrate == 0)
+    {
+        std::cout <<"out of range arguments passed, exit...\n";
+        return 0;
+    }
+    if(estimate)
+    {
+        printEstimate(config, image_size);
+        return 0;
+    }
+
+    BusSimulator bus(config);
+    if(!bus.open(argv[1]))
+    {
+        std::cout <<"failed to open ports, exit...\n";
+        return 0;
+    }
+    std::printf("client port: %s\n", bus.getClientPath().c_str());
+
+    active_bus = &bus;
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    const auto start = BusClock::now();
+    bus.run();
+    const auto elapsed = BusClock::now() - start;
+
+    const BusCounters counters = bus.getCounters();
+    const double utilisation = std::chrono::duration<double>(counters.busy_time).count() / std::chrono::duration<double>(elapsed).count();
+    std::printf("\nrequests: %llu (%llu bytes), responses: %llu (%llu bytes)\n",
+                static_cast<unsigned long long>(counters.frames[0]), static_cast<unsigned long long>(counters.bytes[0]),
+                static_cast<unsigned long long>(counters.frames[1]), static_cast<unsigned long long>(counters.bytes[1]));
+    std::printf("crc errors: %llu, dropped bytes: %llu, lost frames: %llu, bus utilisation: %.1f%%\n",
+                static_cast<unsigned long long>(counters.crc_errors), static_cast<unsigned long long>(counters.dropped_bytes),
+                static_cast<unsigned long long>(counters.lost_frames), utilisation * 100.0);
+    return 0;
+}
@@ -0,0 +1,345 @@
+/**
+ * @file farm.cpp
+ *
+ * @brief many ModbusServer instances behind pseudo terminals
+ *
+ * @author
+ *
+ */
+
+#include "farm.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <termios.h>
+#include <unistd.h>
+#include "../../../core/common/sm_common.hpp"
+
+namespace
+{
+// epoll user data for non port descriptors
+constexpr std::uint64_t delay_event = UINT64_MAX;
+constexpr std::uint64_t wake_event = UINT64_MAX - 1;
+} // namespace
+
+Device::Device(const DeviceConfig& config) :
+    config(config), server(config.address, config.record_size), application(farm_application_file_size, 0xFF), metadata(farm_metadata_file_size, 0xFF)
+{
+    const sm::Attributes read_write{true, true, false};
+    const sm::Attributes read_only{true, false, false};
+    sm::ServerResources& resources = server.getResources();
+    // every device reports its own address in status register, so scanning clients can tell them apart
+    resources.setRegister(sm::RegisterDefinitions::status, sm::RegisterInfo(read_only, config.address));
+    resources.setFile(sm::FileDefinitions::application, sm::FileInfo(read_write, sm::FileData{application.data(), farm_application_file_size}));
+    resources.setFile(sm::FileDefinitions::metadata, sm::FileInfo(read_write, sm::FileData{metadata.data(), farm_metadata_file_size}));
+}
+
+DeviceFarm::DeviceFarm() :
+    epoll_fd(epoll_create1(EPOLL_CLOEXEC)), delay_fd(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)), wake_fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+{
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = delay_event;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, delay_fd, &event);
+    event.data.u64 = wake_event;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+}
+
+DeviceFarm::~DeviceFarm()
+{
+    for (auto& port : ports)
+    {
+        close(port->master_fd);
+        close(port->slave_fd);
+    }
+    close(delay_fd);
+    close(wake_fd);
+    close(epoll_fd);
+}
+
+int DeviceFarm::addPort()
+{
+    auto port = std::make_unique<Port>();
+    port->master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if ((port->master_fd < 0) || (grantpt(port->master_fd) != 0) || (unlockpt(port->master_fd) != 0))
+    {
+        return -1;
+    }
+    port->path = ptsname(port->master_fd);
+    port->slave_fd = open(port->path.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (port->slave_fd < 0)
+    {
+        close(port->master_fd);
+        return -1;
+    }
+    termios tty;
+    tcgetattr(port->slave_fd, &tty);
+    cfmakeraw(&tty);
+    tcsetattr(port->slave_fd, TCSANOW, &tty);
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = ports.size();
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, port->master_fd, &event);
+    ports.push_back(std::move(port));
+    return static_cast<int>(ports.size() - 1);
+}
+
+bool DeviceFarm::addDevice(const DeviceConfig& config)
+{
+    if ((config.port >= ports.size()) || (config.address < modbus::min_rtu_address) || (config.address > modbus::max_rtu_address))
+    {
+        return false;
+    }
+    Port& port = *ports[config.port];
+    if (port.devices[config.address] != nullptr)
+    {
+        return false;
+    }
+    devices.push_back(std::make_unique<Device>(config));
+    port.devices[config.address] = devices.back().get();
+    return true;
+}
+
+void DeviceFarm::run()
+{
+    std::array<epoll_event, 64> events;
+    while (!loop_stop.load(std::memory_order_relaxed))
+    {
+        int amount = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+        for (int i = 0; i < amount; ++i)
+        {
+            const std::uint64_t source = events[i].data.u64;
+            if (source == delay_event)
+            {
+                std::uint64_t expirations = 0;
+                [[maybe_unused]] auto result = read(delay_fd, &expirations, sizeof(expirations));
+                sendDelayed();
+            }
+            else if (source == wake_event)
+            {
+                std::uint64_t counter = 0;
+                [[maybe_unused]] auto result = read(wake_fd, &counter, sizeof(counter));
+            }
+            else
+            {
+                if ((events[i].events & EPOLLOUT) != 0)
+                {
+                    flush(static_cast<size_t>(source));
+                }
+                if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0)
+                {
+                    receive(static_cast<size_t>(source));
+                }
+            }
+        }
+    }
+}
+
+void DeviceFarm::stop()
+{
+    const std::uint64_t counter = 1;
+    loop_stop.store(true, std::memory_order_relaxed);
+    [[maybe_unused]] auto result = write(wake_fd, &counter, sizeof(counter));
+}
+
+void DeviceFarm::receive(const size_t index)
+{
+    Port& port = *ports[index];
+    const auto now = std::chrono::steady_clock::now();
+    if ((port.rx_length != 0) && ((now - port.last_rx) > farm_frame_timeout))
+    {
+        counters.dropped_bytes += port.rx_length;
+        port.rx_length = 0;
+    }
+    ssize_t result = read(port.master_fd, port.rx.data() + port.rx_length, port.rx.size() - port.rx_length);
+    if (result <= 0)
+    {
+        return;
+    }
+    port.rx_length += static_cast<size_t>(result);
+    port.last_rx = now;
+    // several frames may arrive in one read, frame boundaries are taken from the headers
+    size_t offset = 0;
+    while (offset < port.rx_length)
+    {
+        const std::uint8_t available = static_cast<std::uint8_t>(std::min<size_t>(port.rx_length - offset, modbus::max_adu_size));
+        const std::uint16_t length = sm::ModbusServer::getRequestLength(port.rx.data() + offset, available);
+        if ((length == 0) || (length > modbus::max_adu_size))
+        {
+            if (length > modbus::max_adu_size)
+            {
+                // broken header, resynchronize on next byte
+                ++counters.dropped_bytes;
+                ++offset;
+                continue;
+            }
+            break;
+        }
+        if (available < length)
+        {
+            break;
+        }
+        processFrame(index, port.rx.data() + offset, static_cast<std::uint8_t>(length));
+        offset += length;
+    }
+    if (offset != 0)
+    {
+        port.rx_length -= offset;
+        std::memmove(port.rx.data(), port.rx.data() + offset, port.rx_length);
+    }
+}
+
+void DeviceFarm::processFrame(const size_t index, const std::uint8_t* frame, const std::uint8_t length)
+{
+    Port& port = *ports[index];
+    ++counters.rx_frames;
+    if (frame[0] == modbus::broadcast_address)
+    {
+        // every device on the bus executes the request, nobody responds
+        for (Device* device : port.devices)
+        {
+            if (device != nullptr)
+            {
+                std::array<std::uint8_t, modbus::max_adu_size> request;
+                std::memcpy(request.data(), frame, length);
+                device->getServer().serverTask(request.data(), length);
+            }
+        }
+        return;
+    }
+    Device* device = port.devices[frame[0]];
+    if (device == nullptr)
+    {
+        // frame for a device which is not simulated on this bus
+        ++counters.ignored_frames;
+        return;
+    }
+    Response response;
+    std::memcpy(response.data.data(), frame, length);
+    device->getServer().serverTask(response.data.data(), length);
+    response.length = device->getServer().getTransmitBufferSize();
+    response.port = index;
+    if (device->getConfig().response_delay.count() == 0)
+    {
+        transmit(index, response.data.data(), response.length);
+    }
+    else
+    {
+        response.due = std::chrono::steady_clock::now() + device->getConfig().response_delay;
+        const bool rearm = delayed.empty() || (response.due < delayed.top().due);
+        delayed.push(response);
+        if (rearm)
+        {
+            armDelay();
+        }
+    }
+}
+
+void DeviceFarm::transmit(const size_t index, const std::uint8_t* data, const std::uint8_t length)
+{
+    if (length == 0)
+    {
+        return;
+    }
+    Port& port = *ports[index];
+    size_t written = 0;
+    // queued responses go first, otherwise frames would be interleaved
+    if (port.tx.empty())
+    {
+        ssize_t result = write(port.master_fd, data, length);
+        if (result > 0)
+        {
+            written = static_cast<size_t>(result);
+        }
+        else if ((result < 0) && (errno != EAGAIN) && (errno != EINTR))
+        {
+            ++counters.dropped_responses;
+            return;
+        }
+    }
+    if (written == length)
+    {
+        ++counters.tx_frames;
+        return;
+    }
+    if ((port.tx.size() + length - written) > farm_tx_buffer_size)
+    {
+        ++counters.dropped_responses;
+        return;
+    }
+    const bool idle = port.tx.empty();
+    port.tx.insert(port.tx.end(), data + written, data + length);
+    ++counters.tx_frames;
+    ++counters.deferred_responses;
+    if (idle)
+    {
+        watchOutput(index, true);
+    }
+}
+
+void DeviceFarm::flush(const size_t index)
+{
+    Port& port = *ports[index];
+    if (port.tx.empty())
+    {
+        watchOutput(index, false);
+        return;
+    }
+    ssize_t result = write(port.master_fd, port.tx.data(), port.tx.size());
+    if (result > 0)
+    {
+        port.tx.erase(port.tx.begin(), port.tx.begin() + result);
+    }
+    else if ((result < 0) && (errno != EAGAIN) && (errno != EINTR))
+    {
+        ++counters.dropped_responses;
+        port.tx.clear();
+    }
+    if (port.tx.empty())
+    {
+        watchOutput(index, false);
+    }
+}
+
+void DeviceFarm::watchOutput(const size_t index, const bool enable)
+{
+    epoll_event event{};
+    event.events = enable ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    event.data.u64 = index;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, ports[index]->master_fd, &event);
+}
+
+void DeviceFarm::sendDelayed()
+{
+    const auto now = std::chrono::steady_clock::now();
+    while (!delayed.empty() && (delayed.top().due <= now))
+    {
+        const Response& response = delayed.top();
+        transmit(response.port, response.data.data(), response.length);
+        delayed.pop();
+    }
+    armDelay();
+}
+
+void DeviceFarm::armDelay()
+{
+    itimerspec spec{};
+    if (!delayed.empty())
+    {
+        auto due = std::chrono::duration_cast<std::chrono::nanoseconds>(delayed.top().due.time_since_epoch()).count();
+        // zero value disarms the timer, overdue response is sent on the next nanosecond
+        if (due <= 0)
+        {
+            due = 1;
+        }
+        spec.it_value.tv_sec = due / 1000000000;
+        spec.it_value.tv_nsec = due % 1000000000;
+    }
+    // steady_clock and CLOCK_MONOTONIC share the same epoch on Linux
+    timerfd_settime(delay_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
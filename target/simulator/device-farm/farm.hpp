@@ -0,0 +1,133 @@
+/**
+ * @file farm.hpp
+ *
+ * @brief many ModbusServer instances behind pseudo terminals
+ *
+ * @author
+ *
+ */
+
+#ifndef FARM_HPP
+#define FARM_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+#include "../../../core/common/sm_modbus.hpp"
+#include "../../../core/server/inc/sm_server.hpp"
+
+constexpr std::uint32_t farm_application_file_size = 64 * 1024;
+constexpr std::uint32_t farm_metadata_file_size = 4 * 1024;
+// partially received frame is dropped if the rest did not arrive in this time
+constexpr std::chrono::milliseconds farm_frame_timeout{50};
+constexpr size_t farm_frame_buffer_size = 256;
+// responses which the terminal did not take yet, newer responses are dropped when it is full
+constexpr size_t farm_tx_buffer_size = 16 * farm_frame_buffer_size;
+
+struct DeviceConfig
+{
+    size_t port = 0;
+    std::uint8_t address = modbus::min_rtu_address;
+    std::uint8_t record_size = 208;
+    std::chrono::microseconds response_delay{0};
+};
+
+struct FarmCounters
+{
+    std::uint64_t rx_frames = 0;
+    std::uint64_t tx_frames = 0;
+    std::uint64_t ignored_frames = 0;
+    std::uint64_t dropped_bytes = 0;
+    std::uint64_t deferred_responses = 0; // partially written, rest sent when terminal is writable
+    std::uint64_t dropped_responses = 0;
+};
+
+class Device
+{
+public:
+    Device(const DeviceConfig& config);
+    sm::ModbusServer& getServer() { return server; }
+    const DeviceConfig& getConfig() const { return config; }
+
+private:
+    DeviceConfig config;
+    sm::ModbusServer server;
+    std::vector<std::uint8_t> application;
+    std::vector<std::uint8_t> metadata;
+};
+
+class DeviceFarm
+{
+public:
+    DeviceFarm();
+    ~DeviceFarm();
+    DeviceFarm(const DeviceFarm&) = delete;
+    DeviceFarm& operator=(const DeviceFarm&) = delete;
+    /**
+     * @brief create new pseudo terminal for devices
+     *
+     * @return port index, -1 in case of error
+     */
+    int addPort();
+    /**
+     * @brief add device to the port selected in config
+     *
+     * @return false if port does not exist or address is already used on this port
+     */
+    bool addDevice(const DeviceConfig& config);
+    std::string getPortPath(const size_t port) const { return ports[port]->path; }
+    size_t getNumOfPorts() const { return ports.size(); }
+    size_t getNumOfDevices() const { return devices.size(); }
+    /**
+     * @brief run event loop until stop() is called
+     *
+     */
+    void run();
+    void stop();
+    FarmCounters getCounters() const { return counters; }
+
+private:
+    struct Port
+    {
+        int master_fd = -1;
+        int slave_fd = -1; // keeps terminal alive while no client is connected
+        std::string path;
+        std::array<Device*, modbus::max_rtu_address + 1> devices{}; // direct lookup by address
+        std::array<std::uint8_t, farm_frame_buffer_size> rx{};
+        size_t rx_length = 0;
+        std::chrono::steady_clock::time_point last_rx;
+        std::vector<std::uint8_t> tx; // unsent part of responses, EPOLLOUT is enabled while not empty
+    };
+    struct Response
+    {
+        std::chrono::steady_clock::time_point due;
+        size_t port = 0;
+        std::uint8_t length = 0;
+        std::array<std::uint8_t, farm_frame_buffer_size> data{};
+        bool operator>(const Response& other) const { return due > other.due; }
+    };
+    std::vector<std::unique_ptr<Port>> ports;
+    std::vector<std::unique_ptr<Device>> devices;
+    std::priority_queue<Response, std::vector<Response>, std::greater<Response>> delayed;
+    int epoll_fd = -1;
+    int delay_fd = -1; // timerfd armed to the earliest delayed response
+    int wake_fd = -1;
+    std::atomic<bool> loop_stop{false};
+    FarmCounters counters;
+
+    void receive(const size_t port);
+    void processFrame(const size_t port, const std::uint8_t* frame, const std::uint8_t length);
+    void transmit(const size_t port, const std::uint8_t* data, const std::uint8_t length);
+    void flush(const size_t port);
+    void watchOutput(const size_t port, const bool enable);
+    void sendDelayed();
+    void armDelay();
+};
+
+#endif // FARM_HPP
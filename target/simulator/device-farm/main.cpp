@@ -0,0 +1,140 @@
+/**
+ * @file main.cpp
+ *
+ * @brief simulator of many Modbus devices for client load tests
+ *
+ * @author
+ *
+ */
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "farm.hpp"
+
+namespace
+{
+
+constexpr std::uint8_t record_sizes[] = {64, 128, 208, 240};
+
+DeviceFarm* active_farm = nullptr;
+
+void onSignal(int) 
+{
+    if(active_farm != nullptr)
+    {
+        active_farm->stop();
+    }
+}
+
+void printUsage()
+{
+    std::printf("usage: sm_device_farm <ports> <devices> [first address] [response delay us]\n");
+    std::printf("       sm_device_farm -f <config>, config line: <port> <address> <record size> <response delay us>\n");
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if(argc < 3)
+    {
+        printUsage();
+        return 0;
+    }
+    std::vector<DeviceConfig> configs;
+    size_t num_of_ports = 0;
+    try
+    {
+        if(std::string(argv[1]) == "-f")
+        {
+            std::ifstream config_file(argv[2]);
+            std::string line;
+            while(std::getline(config_file, line))
+            {
+                std::istringstream stream(line);
+                unsigned port = 0, address = 0, record_size = 0, delay = 0;
+                if((line.empty()) || (line[0] == '#') || !(stream >> port >> address >> record_size >> delay))
+                {
+                    continue;
+                }
+                DeviceConfig config;
+                config.port = port;
+                config.address = static_cast<std::uint8_t>(address);
+                config.record_size = static_cast<std::uint8_t>(record_size);
+                config.response_delay = std::chrono::microseconds(delay);
+                configs.push_back(config);
+                num_of_ports = std::max<size_t>(num_of_ports, port + 1);
+            }
+        }
+        else
+        {
+            num_of_ports = std::stoul(argv[1]);
+            const unsigned num_of_devices = std::stoul(argv[2]);
+            const unsigned first_address = (argc > 3) ? std::stoul(argv[3]) : modbus::min_rtu_address;
+            const unsigned delay = (argc > 4) ? std::stoul(argv[4]) : 0;
+            if((num_of_ports == 0) || (first_address < modbus::min_rtu_address) ||
+               (num_of_devices > (num_of_ports * (modbus::max_rtu_address - first_address + 1))))
+            {
+                std::cout <<"out of range arguments passed, exit...\n";
+                return 0;
+            }
+            // devices are spread over ports, addresses are unique within one port
+            for(unsigned i = 0; i < num_of_devices; ++i)
+            {
+                DeviceConfig config;
+                config.port = i % num_of_ports;
+                config.address = static_cast<std::uint8_t>(first_address + (i / num_of_ports));
+                config.record_size = record_sizes[i % std::size(record_sizes)];
+                config.response_delay = std::chrono::microseconds(delay);
+                configs.push_back(config);
+            }
+        }
+    }
+    catch (std::exception const& ex)
+    {
+        std::cout <<"invalid argument passed, exit...\n";
+        return 0;
+    }
+
+    DeviceFarm farm;
+    for(size_t i = 0; i < num_of_ports; ++i)
+    {
+        if(farm.addPort() < 0)
+        {
+            std::cout <<"failed to create pseudo terminal, exit...\n";
+            return 0;
+        }
+    }
+    for(const auto& config : configs)
+    {
+        if(!farm.addDevice(config))
+        {
+            std::printf("device %u on port %zu skipped\n", config.address, config.port);
+        }
+    }
+    for(size_t i = 0; i < farm.getNumOfPorts(); ++i)
+    {
+        std::printf("port %zu: %s\n", i, farm.getPortPath(i).c_str());
+    }
+    std::printf("%zu devices started.\n", farm.getNumOfDevices());
+
+    active_farm = &farm;
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    farm.run();
+
+    const FarmCounters counters = farm.getCounters();
+    std::printf("\nrx frames: %llu, tx frames: %llu, ignored frames: %llu, dropped bytes: %llu\n",
+                static_cast<unsigned long long>(counters.rx_frames), static_cast<unsigned long long>(counters.tx_frames),
+                static_cast<unsigned long long>(counters.ignored_frames), static_cast<unsigned long long>(counters.dropped_bytes));
+    std::printf("deferred responses: %llu, dropped responses: %llu\n", static_cast<unsigned long long>(counters.deferred_responses),
+                static_cast<unsigned long long>(counters.dropped_responses));
+    return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file test_cache.cpp
+ *
+ * @brief register cache stays consistent with the server after register writes
+ *
+ * @author
+ *
+ */
+
+#include <chrono>
+#include <vector>
+#include "sm_client.hpp"
+#include "test_common.hpp"
+
+namespace
+{
+
+constexpr std::uint8_t server_address = 1;
+constexpr std::uint16_t record_counter_addr = modbus::holding_regs_offset + static_cast<std::uint16_t>(sm::RegisterDefinitions::record_counter);
+constexpr std::uint16_t status_addr = modbus::holding_regs_offset + static_cast<std::uint16_t>(sm::RegisterDefinitions::status);
+constexpr std::chrono::milliseconds max_age{60000};
+
+} // namespace
+
+int main()
+{
+    test::FarmRunner farm;
+    if (!TEST_CHECK(farm.addDevice(server_address)))
+    {
+        return test::report("test_cache");
+    }
+    farm.start();
+
+    sp::PortConfig config;
+    config.baudrate = sp::PortBaudRate::BD_57600;
+    config.timeout_ms = 500;
+    sm::ModbusClient client;
+    TEST_CHECK(!client.start(farm.getPath()));
+    TEST_CHECK(!client.configure(config));
+    client.addServer(server_address);
+    TEST_CHECK(!client.taskPing(server_address));
+
+    std::vector<std::uint16_t> values;
+    const std::vector<sm::RegisterRange> ranges{{record_counter_addr, 2}};
+    TEST_CHECK(!client.taskReadRegistersCached(server_address, ranges, max_age));
+    TEST_CHECK(client.getCachedRegisters(server_address, {record_counter_addr, 2}, max_age, values));
+
+    // successful write replaces cached value without another read
+    const std::uint16_t new_value = 7;
+    TEST_CHECK(!client.taskWriteRegister(server_address, record_counter_addr, new_value));
+    values.clear();
+    TEST_CHECK(client.getCachedRegisters(server_address, {record_counter_addr, 1}, max_age, values));
+    TEST_CHECK((values.size() == 1) && (values[0] == new_value));
+
+    // rejected write leaves the server state unknown, range must be read again
+    TEST_CHECK(!!client.taskWriteRegisters(server_address, record_counter_addr, {new_value + 1, 0}));
+    values.clear();
+    TEST_CHECK(!client.getCachedRegisters(server_address, {record_counter_addr, 2}, max_age, values));
+    TEST_CHECK(!client.taskReadRegistersCached(server_address, ranges, max_age));
+    values.clear();
+    TEST_CHECK(client.getCachedRegisters(server_address, {record_counter_addr, 1}, max_age, values));
+    TEST_CHECK((values.size() == 1) && (values[0] == new_value));
+
+    // registers outside of the written range stay cached
+    values.clear();
+    TEST_CHECK(client.getCachedRegisters(server_address, {status_addr, 1}, max_age, values));
+
+    return test::report("test_cache");
+}
@@ -0,0 +1,78 @@
+/**
+ * @file test_common.hpp
+ *
+ * @brief checks and simulated devices shared by desktop tests
+ *
+ * @author
+ *
+ */
+
+#ifndef TEST_COMMON_HPP
+#define TEST_COMMON_HPP
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include "farm.hpp"
+
+#define TEST_CHECK(condition) test::check((condition), #condition, __FILE__, __LINE__)
+
+namespace test
+{
+
+inline int failures = 0;
+
+inline bool check(const bool result, const char* text, const char* file, const int line)
+{
+    if (!result)
+    {
+        std::printf("%s:%d: check failed: %s\n", file, line, text);
+        ++failures;
+    }
+    return result;
+}
+
+inline int report(const char* name)
+{
+    std::printf("%s: %s\n", name, (failures == 0) ? "passed" : "FAILED");
+    return (failures == 0) ? 0 : 1;
+}
+
+// device farm with one port, event loop runs until the runner is destroyed
+class FarmRunner
+{
+public:
+    FarmRunner()
+    {
+        port = farm.addPort();
+    }
+    ~FarmRunner()
+    {
+        farm.stop();
+        if (loop.joinable())
+        {
+            loop.join();
+        }
+    }
+    FarmRunner(const FarmRunner&) = delete;
+    FarmRunner& operator=(const FarmRunner&) = delete;
+    bool addDevice(const std::uint8_t address, const std::uint8_t record_size = 208)
+    {
+        DeviceConfig config;
+        config.port = static_cast<size_t>(port);
+        config.address = address;
+        config.record_size = record_size;
+        return (port >= 0) && farm.addDevice(config);
+    }
+    void start() { loop = std::thread(&DeviceFarm::run, &farm); }
+    std::string getPath() const { return (port >= 0) ? farm.getPortPath(static_cast<size_t>(port)) : std::string(); }
+
+private:
+    DeviceFarm farm;
+    int port = -1;
+    std::thread loop;
+};
+
+} // namespace test
+
+#endif // TEST_COMMON_HPP
@@ -0,0 +1,84 @@
+/**
+ * @file test_file_transfer.cpp
+ *
+ * @brief file transfer setup does not depend on the state left by previous transfers
+ *
+ * @author
+ *
+ */
+
+#include <cstring>
+#include <vector>
+#include "sm_client.hpp"
+#include "test_common.hpp"
+
+namespace
+{
+
+constexpr std::uint8_t server_address = 1;
+constexpr std::uint8_t record_size = 208;
+constexpr size_t file_size = (record_size * 5) + 20;
+constexpr std::uint16_t file_segment_addr = modbus::holding_regs_offset + sm::RegisterDefinitions::file_segment;
+constexpr std::uint16_t prepare_to_update_addr = modbus::holding_regs_offset + sm::RegisterDefinitions::prepare_to_update;
+constexpr std::uint16_t update_request = 0x5A;
+
+std::vector<std::uint8_t> makeImage(const size_t size, const std::uint8_t seed)
+{
+    std::vector<std::uint8_t> image(size);
+    for (size_t i = 0; i < image.size(); ++i)
+    {
+        image[i] = static_cast<std::uint8_t>((i * 13) + seed);
+    }
+    return image;
+}
+
+bool readBack(sm::ModbusClient& client, const std::vector<std::uint8_t>& image)
+{
+    return !client.taskReadFile(server_address, sm::FileDefinitions::application, image.size()) && (client.file.getSize() == image.size()) &&
+           (std::memcmp(client.file.getData(), image.data(), image.size()) == 0);
+}
+
+} // namespace
+
+int main()
+{
+    test::FarmRunner farm;
+    if (!TEST_CHECK(farm.addDevice(server_address, record_size)))
+    {
+        return test::report("test_file_transfer");
+    }
+    farm.start();
+
+    sp::PortConfig config;
+    config.baudrate = sp::PortBaudRate::BD_57600;
+    config.timeout_ms = 500;
+    sm::ModbusClient client;
+    TEST_CHECK(!client.start(farm.getPath()));
+    TEST_CHECK(!client.configure(config));
+    client.addServer(server_address);
+    TEST_CHECK(!client.taskPing(server_address));
+    TEST_CHECK(client.setServerRecordMaxSize(server_address, record_size));
+
+    // segmented write aborted in the second segment leaves the segment registers selected
+    TEST_CHECK(!client.taskWriteRegisters(server_address, file_segment_addr, {1, 2}));
+
+    const auto image = makeImage(file_size, 1);
+    TEST_CHECK(client.file.fileWriteSetupFromMemory(sm::FileDefinitions::application, image, record_size));
+    TEST_CHECK(!client.taskWriteFile(server_address));
+    TEST_CHECK(!client.taskVerifyFile(server_address));
+    TEST_CHECK(readBack(client, image));
+    // reading the file back keeps the digest of the last write
+    TEST_CHECK(client.file.fileWriteSetupFromMemory(sm::FileDefinitions::application, image, record_size));
+    TEST_CHECK(!client.taskVerifyFile(server_address));
+
+    // application state is not changed by the transfer setup
+    TEST_CHECK(!client.taskWriteRegister(server_address, prepare_to_update_addr, update_request));
+    TEST_CHECK(client.file.fileWriteSetupFromMemory(sm::FileDefinitions::application, image, record_size));
+    TEST_CHECK(!client.taskWriteFile(server_address));
+    TEST_CHECK(!client.taskReadRegisters(server_address, prepare_to_update_addr, 1));
+    sm::ServerRegisters registers;
+    client.getLastServerRegList(server_address, registers);
+    TEST_CHECK((registers.values.size() == 1) && (registers.values[0] == update_request));
+
+    return test::report("test_file_transfer");
+}
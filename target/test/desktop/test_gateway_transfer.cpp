@@ -0,0 +1,226 @@
+/**
+ * @file test_gateway_transfer.cpp
+ *
+ * @brief broadcast file transfer through the gateway, lost record is found in the record map and written again
+ *
+ * @author
+ *
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <future>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+#include "platform.hpp"
+#include "sm_client.hpp"
+#include "sm_gateway.hpp"
+#include "test_common.hpp"
+
+namespace
+{
+
+constexpr std::uint8_t gateway_address = 1;
+constexpr std::uint8_t server_address = 2;
+constexpr std::uint8_t record_size = 208;
+constexpr size_t file_size = (record_size * 10) + 50;
+constexpr std::uint32_t baudrate = 57600;
+// broadcast write of this record is not passed to the gateway
+constexpr size_t dropped_record = 3;
+
+// two pseudo terminals joined by a thread, requests of the client are passed frame by frame
+class FrameBridge
+{
+public:
+    ~FrameBridge()
+    {
+        stop.store(true, std::memory_order_relaxed);
+        if (bridge_thread.joinable())
+        {
+            bridge_thread.join();
+        }
+        for (auto& end : ends)
+        {
+            close(end.master_fd);
+            close(end.slave_fd);
+        }
+    }
+    bool open()
+    {
+        for (auto& end : ends)
+        {
+            end.master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+            if ((end.master_fd < 0) || (grantpt(end.master_fd) != 0) || (unlockpt(end.master_fd) != 0))
+            {
+                return false;
+            }
+            end.path = ptsname(end.master_fd);
+            // slave is kept open, so the terminal survives reopening by the client
+            end.slave_fd = ::open(end.path.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+            if (end.slave_fd < 0)
+            {
+                return false;
+            }
+            termios tty;
+            tcgetattr(end.slave_fd, &tty);
+            cfmakeraw(&tty);
+            tcsetattr(end.slave_fd, TCSANOW, &tty);
+        }
+        bridge_thread = std::thread(&FrameBridge::bridgeThread, this);
+        return true;
+    }
+    const std::string& getClientPath() const { return ends[0].path; }
+    const std::string& getGatewayPath() const { return ends[1].path; }
+    size_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct End
+    {
+        int master_fd = -1;
+        int slave_fd = -1;
+        std::string path;
+    };
+    std::array<End, 2> ends;
+    std::vector<std::uint8_t> request;
+    size_t broadcast_records = 0;
+    std::atomic<size_t> dropped{0};
+    std::atomic<bool> stop{false};
+    std::thread bridge_thread;
+    static void writeAll(const int fd, const std::uint8_t* data, size_t length)
+    {
+        while (length != 0)
+        {
+            const auto written = write(fd, data, length);
+            if (written <= 0)
+            {
+                pollfd out{fd, POLLOUT, 0};
+                poll(&out, 1, 10);
+                continue;
+            }
+            data += written;
+            length -= static_cast<size_t>(written);
+        }
+    }
+    void passRequests()
+    {
+        while (request.size() >= (modbus::address_size + modbus::function_size))
+        {
+            const auto available = static_cast<std::uint8_t>(std::min<size_t>(request.size(), modbus::max_adu_size));
+            const std::uint16_t length = sm::ModbusServer::getRequestLength(request.data(), available);
+            if ((length == 0) || (length > request.size()))
+            {
+                return;
+            }
+            const bool broadcast_record = (request[0] == modbus::broadcast_address) &&
+                                          (request[1] == static_cast<std::uint8_t>(modbus::FunctionCodes::write_file));
+            if (broadcast_record && (broadcast_records++ == dropped_record))
+            {
+                ++dropped;
+            }
+            else
+            {
+                writeAll(ends[1].master_fd, request.data(), length);
+            }
+            request.erase(request.begin(), request.begin() + length);
+        }
+    }
+    void bridgeThread()
+    {
+        std::array<std::uint8_t, 512> data;
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            std::array<pollfd, 2> fds{pollfd{ends[0].master_fd, POLLIN, 0}, pollfd{ends[1].master_fd, POLLIN, 0}};
+            if (poll(fds.data(), fds.size(), 20) <= 0)
+            {
+                continue;
+            }
+            if (fds[0].revents & POLLIN)
+            {
+                const auto received = read(ends[0].master_fd, data.data(), data.size());
+                if (received > 0)
+                {
+                    request.insert(request.end(), data.begin(), data.begin() + received);
+                    passRequests();
+                }
+            }
+            if (fds[1].revents & POLLIN)
+            {
+                const auto received = read(ends[1].master_fd, data.data(), data.size());
+                if (received > 0)
+                {
+                    writeAll(ends[0].master_fd, data.data(), static_cast<size_t>(received));
+                }
+            }
+        }
+    }
+};
+
+} // namespace
+
+PlatformSupport platform_support;
+
+int main()
+{
+    sp::PortConfig config;
+    config.baudrate = sp::PortBaudRate::BD_57600;
+    config.timeout_ms = 1000;
+
+    test::FarmRunner farm;
+    FrameBridge bridge;
+    if (!TEST_CHECK(farm.addDevice(server_address, record_size)) || !TEST_CHECK(bridge.open()))
+    {
+        return test::report("test_gateway_transfer");
+    }
+    farm.start();
+
+    // gateway loop never returns, the test is finished with _Exit()
+    std::promise<void> gateway_started;
+    std::string upstream_path = bridge.getGatewayPath();
+    platform_support.setPath(upstream_path);
+    platform_support.setConfig(config);
+    std::thread([&gateway_started, downstream_path = farm.getPath(), config]()
+    {
+        sm::GatewayNode<DesktopCom, DesktopTimer, DesktopWaitPolicy> gateway(gateway_address, record_size);
+        gateway.setRoute(server_address, server_address, 0);
+        gateway.getDownstream(0).setPort(downstream_path, config);
+        gateway.start();
+        gateway_started.set_value();
+        gateway.loop();
+    }).detach();
+    gateway_started.get_future().wait();
+
+    sm::ModbusClient client;
+    TEST_CHECK(!client.start(bridge.getClientPath()));
+    TEST_CHECK(!client.configure(config));
+    client.addServer(gateway_address);
+    client.addServer(server_address, gateway_address);
+    TEST_CHECK(!client.taskPing(gateway_address));
+    TEST_CHECK(!client.taskPing(server_address));
+
+    std::vector<std::uint8_t> image(file_size);
+    for (size_t i = 0; i < image.size(); ++i)
+    {
+        image[i] = static_cast<std::uint8_t>((i * 7) + (i >> 8));
+    }
+    TEST_CHECK(client.file.fileWriteSetupFromMemory(sm::FileDefinitions::application, image, record_size));
+    std::vector<std::error_code> results;
+    TEST_CHECK(!client.taskBroadcastFile({server_address}, baudrate, results));
+    TEST_CHECK((results.size() == 1) && !results[0]);
+    TEST_CHECK(bridge.getDropped() == 1);
+    TEST_CHECK(!client.taskVerifyFile(server_address));
+
+    // file is read back through the gateway
+    TEST_CHECK(client.setServerRecordMaxSize(server_address, record_size));
+    TEST_CHECK(!client.taskReadFile(server_address, sm::FileDefinitions::application, file_size));
+    TEST_CHECK((client.file.getSize() == image.size()) && (std::memcmp(client.file.getData(), image.data(), image.size()) == 0));
+
+    const int result = test::report("test_gateway_transfer");
+    std::fflush(stdout);
+    std::_Exit(result);
+}